@@ -0,0 +1,265 @@
+// throf-bench : runs the benchmark corpus against a throf binary and compares the
+// results with a stored baseline.
+//
+//   throf-bench [--throf <binary>] [--runs <n>] [--threshold <percent>]
+//               [--baseline <file>] [--save <file>] <workload.th4> ...
+//
+// Every workload is run once to warm the file cache and then <n> times; the median
+// wall time is what gets compared. Besides the .th4 files given on the command line
+// a generated workload measures lexing and compiling a large source file.
+//
+// Results go to stdout, one tab separated line per workload:
+//
+//   workload  median_ms  min_ms  runs  baseline_ms  change_%  status
+//
+// status is ok, faster, REGRESSION, new (not in the baseline) or FAILED. The exit code
+// is 1 if any workload regressed by more than the threshold or failed to run.
+//
+// Baseline files hold "workload median_ms" lines; --save writes one.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+static const char* const GENERATED_WORKLOAD = "generated/lex-compile";
+static const int GENERATED_DEFINITIONS = 20000;
+
+struct Result
+{
+    std::string workload;
+    double medianMs;
+    double minMs;
+    int runs;
+    bool failed;
+};
+
+// a large source with many definitions, comments, string literals and quotations
+static bool writeGeneratedSource(const std::string& filename)
+{
+    std::ofstream out(filename.c_str());
+    if (!out)
+    {
+        return false;
+    }
+
+    out << "# generated by throf-bench" << std::endl;
+    for (int ii = 0; ii < GENERATED_DEFINITIONS; ii++)
+    {
+        out << ": gen" << ii << " ( x -- y )" << std::endl;
+        out << "    dup " << ii << " > [ " << ii << " - ] [ \"word " << ii << "\" drop ] if ;" << std::endl;
+        if (ii > 0 && ii % 100 == 0)
+        {
+            out << ii << " gen" << ii - 1 << " drop" << std::endl;
+        }
+    }
+    return true;
+}
+
+// wall time of one run in milliseconds, or a negative number if it did not succeed;
+// throf exits nonzero when a workload aborts with an error
+static double runOnce(const std::string& throf, const std::string& workload)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        fprintf(stderr, "ERROR: fork failed, errno = %d\n", errno);
+        return -1;
+    }
+
+    if (pid == 0)
+    {
+        int devNull = open("/dev/null", O_WRONLY);
+        if (devNull >= 0)
+        {
+            dup2(devNull, STDOUT_FILENO);
+            dup2(devNull, STDERR_FILENO);
+            close(devNull);
+        }
+        execl(throf.c_str(), throf.c_str(), workload.c_str(), (char*)nullptr);
+        _exit(127);
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    {
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? ms : -1;
+}
+
+static Result runWorkload(const std::string& throf, const std::string& name, const std::string& filename, int runs)
+{
+    Result result;
+    result.workload = name;
+    result.medianMs = 0;
+    result.minMs = 0;
+    result.runs = runs;
+    result.failed = runOnce(throf, filename) < 0;
+
+    std::vector<double> times;
+    for (int ii = 0; ii < runs && !result.failed; ii++)
+    {
+        double ms = runOnce(throf, filename);
+        result.failed = ms < 0;
+        times.push_back(ms);
+    }
+
+    if (!result.failed)
+    {
+        std::sort(times.begin(), times.end());
+        result.medianMs = times[times.size() / 2];
+        result.minMs = times.front();
+    }
+    return result;
+}
+
+static std::map<std::string, double> readBaseline(const std::string& filename)
+{
+    std::map<std::string, double> baseline;
+    std::ifstream in(filename.c_str());
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        std::string workload;
+        double ms;
+        if (fields >> workload >> ms)
+        {
+            baseline[workload] = ms;
+        }
+    }
+    return baseline;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string throf = "throf/throf";
+    std::string baselineFilename;
+    std::string saveFilename;
+    int runs = 5;
+    double threshold = 10.0;
+    std::vector<std::string> workloads;
+
+    for (int ii = 1; ii < argc; ii++)
+    {
+        bool hasValue = ii + 1 < argc;
+        if (0 == strcmp(argv[ii], "--throf") && hasValue)
+        {
+            throf = argv[++ii];
+        }
+        else if (0 == strcmp(argv[ii], "--runs") && hasValue)
+        {
+            runs = atoi(argv[++ii]);
+        }
+        else if (0 == strcmp(argv[ii], "--threshold") && hasValue)
+        {
+            threshold = atof(argv[++ii]);
+        }
+        else if (0 == strcmp(argv[ii], "--baseline") && hasValue)
+        {
+            baselineFilename = argv[++ii];
+        }
+        else if (0 == strcmp(argv[ii], "--save") && hasValue)
+        {
+            saveFilename = argv[++ii];
+        }
+        else if (argv[ii][0] == '-')
+        {
+            fprintf(stderr, "usage: throf-bench [--throf <binary>] [--runs <n>] [--threshold <percent>] "
+                "[--baseline <file>] [--save <file>] <workload.th4> ...\n");
+            return 1;
+        }
+        else
+        {
+            workloads.push_back(argv[ii]);
+        }
+    }
+
+    if (runs < 1)
+    {
+        runs = 1;
+    }
+
+    std::vector<Result> results;
+    for (size_t ii = 0; ii < workloads.size(); ii++)
+    {
+        results.push_back(runWorkload(throf, workloads[ii], workloads[ii], runs));
+    }
+
+    char generated[] = "/tmp/throf-bench-XXXXXX";
+    int generatedFd = mkstemp(generated);
+    if (generatedFd < 0 || !writeGeneratedSource(generated))
+    {
+        fprintf(stderr, "ERROR: could not write the generated workload, errno = %d\n", errno);
+        return 1;
+    }
+    close(generatedFd);
+    results.push_back(runWorkload(throf, GENERATED_WORKLOAD, generated, runs));
+    unlink(generated);
+
+    std::map<std::string, double> baseline;
+    if (!baselineFilename.empty())
+    {
+        baseline = readBaseline(baselineFilename);
+    }
+
+    bool regressed = false;
+    printf("# workload\tmedian_ms\tmin_ms\truns\tbaseline_ms\tchange_%%\tstatus\n");
+    for (size_t ii = 0; ii < results.size(); ii++)
+    {
+        const Result& r = results[ii];
+        auto base = baseline.find(r.workload);
+        const char* status = "new";
+        double baseMs = 0, change = 0;
+
+        if (r.failed)
+        {
+            status = "FAILED";
+            regressed = true;
+        }
+        else if (base != baseline.end() && (*base).second > 0)
+        {
+            baseMs = (*base).second;
+            change = 100.0 * (r.medianMs - baseMs) / baseMs;
+            status = change > threshold ? "REGRESSION" : (change < -threshold ? "faster" : "ok");
+            regressed = regressed || change > threshold;
+        }
+
+        printf("%s\t%.3f\t%.3f\t%d\t%.3f\t%+.1f\t%s\n", r.workload.c_str(), r.medianMs, r.minMs, r.runs, baseMs, change, status);
+    }
+
+    if (!saveFilename.empty())
+    {
+        std::ofstream out(saveFilename.c_str());
+        out << "# workload median_ms, written by throf-bench" << std::endl;
+        for (size_t ii = 0; ii < results.size(); ii++)
+        {
+            if (!results[ii].failed)
+            {
+                out << results[ii].workload << " " << results[ii].medianMs << std::endl;
+            }
+        }
+    }
+
+    return regressed ? 1 : 0;
+}
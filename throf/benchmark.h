@@ -0,0 +1,106 @@
+#pragma once
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define THROF_HAS_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define THROF_HAS_RDTSC 1
+#endif
+
+namespace throf
+{
+    // Helpers behind the `bench` word. Every iteration is timed on its own with
+    // steady_clock, so the summary can report the spread and not just the mean; the
+    // cost of reading the clock is measured once and taken off each sample. Where the
+    // CPU has a time stamp counter the median is also reported in cycles.
+    class Benchmark
+    {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        struct Summary
+        {
+            unsigned long long minNs;
+            unsigned long long medianNs;
+            unsigned long long p99Ns;
+            unsigned long long maxNs;
+            double meanNs;
+            unsigned long long medianCycles;
+
+            Summary() : minNs(0), medianNs(0), p99Ns(0), maxNs(0), meanNs(0), medianCycles(0) { }
+        };
+
+        static const long MAX_WARMUP_ITERATIONS = 1000;
+
+        // a tenth of the run, at least one iteration and at most MAX_WARMUP_ITERATIONS
+        static long warmupIterations(long iterations)
+        {
+            long warmup = iterations / 10;
+            if (warmup < 1)
+            {
+                warmup = 1;
+            }
+            if (warmup > MAX_WARMUP_ITERATIONS)
+            {
+                warmup = MAX_WARMUP_ITERATIONS;
+            }
+            return warmup;
+        }
+
+        static unsigned long long cycles()
+        {
+#ifdef THROF_HAS_RDTSC
+            return __rdtsc();
+#else
+            return 0;
+#endif
+        }
+
+        // smallest observed cost of a back to back pair of clock reads
+        static unsigned long long clockOverheadNs()
+        {
+            unsigned long long best = ~0ULL;
+            for (int ii = 0; ii < 1000; ii++)
+            {
+                Clock::time_point start = Clock::now();
+                Clock::time_point end = Clock::now();
+                unsigned long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+                best = std::min(best, ns);
+            }
+            return best;
+        }
+
+        // sorts samplesNs and cycleSamples in place
+        static Summary summarize(std::vector<unsigned long long>& samplesNs, std::vector<unsigned long long>& cycleSamples)
+        {
+            Summary summary;
+            if (samplesNs.empty())
+            {
+                return summary;
+            }
+
+            std::sort(samplesNs.begin(), samplesNs.end());
+            std::sort(cycleSamples.begin(), cycleSamples.end());
+
+            size_t count = samplesNs.size();
+            summary.minNs = samplesNs.front();
+            summary.medianNs = samplesNs[count / 2];
+            summary.p99Ns = samplesNs[std::min(count - 1, count * 99 / 100)];
+            summary.maxNs = samplesNs.back();
+
+            double total = 0;
+            for (auto itr = samplesNs.cbegin(); itr != samplesNs.cend(); itr++)
+            {
+                total += *itr;
+            }
+            summary.meanNs = total / count;
+
+            if (!cycleSamples.empty())
+            {
+                summary.medianCycles = cycleSamples[cycleSamples.size() / 2];
+            }
+            return summary;
+        }
+    };
+}
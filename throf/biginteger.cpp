@@ -0,0 +1,344 @@
+#include "stdafx.h"
+#include <iomanip>
+
+namespace throf
+{
+    static const uint64_t LIMB_BASE = 1ULL << 32;
+
+    // the largest power of ten in a limb, for converting to and from decimal in chunks
+    static const uint32_t DECIMAL_CHUNK = 1000000000;
+    static const int DECIMAL_CHUNK_DIGITS = 9;
+
+    BigInteger::BigInteger(int64_t value) :
+        _negative(value < 0)
+    {
+        // negating in unsigned arithmetic keeps INT64_MIN well defined
+        uint64_t magnitude = _negative ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+        while (magnitude != 0)
+        {
+            _magnitude.push_back(static_cast<uint32_t>(magnitude));
+            magnitude >>= 32;
+        }
+    }
+
+    BigInteger::BigInteger(const BigInteger& other, const ResourceAllocator<uint32_t>& allocator) :
+        _negative(other._negative),
+        _magnitude(other._magnitude.begin(), other._magnitude.end(), allocator)
+    {
+    }
+
+    // static
+    bool BigInteger::parse(const std::string& text, BigInteger& result)
+    {
+        size_t digit = (!text.empty() && (text[0] == '-' || text[0] == '+')) ? 1 : 0;
+        if (digit >= text.size())
+        {
+            return false;
+        }
+        for (size_t ii = digit; ii < text.size(); ii++)
+        {
+            if (!std::isdigit(static_cast<unsigned char>(text[ii])))
+            {
+                return false;
+            }
+        }
+
+        BigInteger parsed;
+        while (digit < text.size())
+        {
+            size_t chunkLength = min(static_cast<size_t>(DECIMAL_CHUNK_DIGITS), text.size() - digit);
+            uint64_t scale = 1, chunk = 0;
+            for (size_t ii = 0; ii < chunkLength; ii++)
+            {
+                scale *= 10;
+                chunk = chunk * 10 + (text[digit + ii] - '0');
+            }
+            digit += chunkLength;
+
+            // parsed = parsed * scale + chunk
+            uint64_t carry = chunk;
+            for (auto itr = parsed._magnitude.begin(); itr != parsed._magnitude.end(); itr++)
+            {
+                uint64_t limb = static_cast<uint64_t>(*itr) * scale + carry;
+                *itr = static_cast<uint32_t>(limb);
+                carry = limb >> 32;
+            }
+            if (carry != 0)
+            {
+                parsed._magnitude.push_back(static_cast<uint32_t>(carry));
+            }
+        }
+
+        parsed._negative = text[0] == '-';
+        parsed.trim();
+        result = std::move(parsed);
+        return true;
+    }
+
+    bool BigInteger::fitsInt64() const
+    {
+        if (_magnitude.size() > 2)
+        {
+            return false;
+        }
+
+        uint64_t magnitude = 0;
+        for (size_t ii = _magnitude.size(); ii > 0; ii--)
+        {
+            magnitude = (magnitude << 32) | _magnitude[ii - 1];
+        }
+        return magnitude <= (_negative ? (1ULL << 63) : (1ULL << 63) - 1);
+    }
+
+    int64_t BigInteger::toInt64() const
+    {
+        uint64_t magnitude = 0;
+        for (size_t ii = min(_magnitude.size(), static_cast<size_t>(2)); ii > 0; ii--)
+        {
+            magnitude = (magnitude << 32) | _magnitude[ii - 1];
+        }
+        return static_cast<int64_t>(_negative ? 0 - magnitude : magnitude);
+    }
+
+    double BigInteger::toDouble() const
+    {
+        double result = 0;
+        for (size_t ii = _magnitude.size(); ii > 0; ii--)
+        {
+            result = result * static_cast<double>(LIMB_BASE) + _magnitude[ii - 1];
+        }
+        return _negative ? -result : result;
+    }
+
+    std::string BigInteger::toString() const
+    {
+        if (isZero())
+        {
+            return "0";
+        }
+
+        // peel off nine digits at a time, least significant first
+        Limbs magnitude(_magnitude);
+        std::vector<uint32_t> chunks;
+        while (!magnitude.empty())
+        {
+            chunks.push_back(divideMagnitude(magnitude, DECIMAL_CHUNK));
+        }
+
+        stringstream strBuilder;
+        if (_negative)
+        {
+            strBuilder << '-';
+        }
+        strBuilder << chunks.back();
+        for (size_t ii = chunks.size() - 1; ii > 0; ii--)
+        {
+            strBuilder << std::setw(DECIMAL_CHUNK_DIGITS) << std::setfill('0') << chunks[ii - 1];
+        }
+        return strBuilder.str();
+    }
+
+    // static
+    int BigInteger::compare(const BigInteger& left, const BigInteger& right)
+    {
+        if (left._negative != right._negative)
+        {
+            return left._negative ? -1 : 1;
+        }
+
+        int magnitude = compareMagnitude(left._magnitude, right._magnitude);
+        return left._negative ? -magnitude : magnitude;
+    }
+
+    // static
+    BigInteger BigInteger::add(const BigInteger& left, const BigInteger& right)
+    {
+        BigInteger result;
+        if (left._negative == right._negative)
+        {
+            addMagnitude(left._magnitude, right._magnitude, result._magnitude);
+            result._negative = left._negative;
+        }
+        else if (compareMagnitude(left._magnitude, right._magnitude) >= 0)
+        {
+            subtractMagnitude(left._magnitude, right._magnitude, result._magnitude);
+            result._negative = left._negative;
+        }
+        else
+        {
+            subtractMagnitude(right._magnitude, left._magnitude, result._magnitude);
+            result._negative = right._negative;
+        }
+        result.trim();
+        return result;
+    }
+
+    // static
+    BigInteger BigInteger::subtract(const BigInteger& left, const BigInteger& right)
+    {
+        BigInteger negated(right, ResourceAllocator<uint32_t>());
+        negated._negative = !negated._negative;
+        negated.trim();
+        return add(left, negated);
+    }
+
+    // static
+    BigInteger BigInteger::multiply(const BigInteger& left, const BigInteger& right)
+    {
+        BigInteger result;
+        if (left.isZero() || right.isZero())
+        {
+            return result;
+        }
+
+        result._magnitude.assign(left._magnitude.size() + right._magnitude.size(), 0);
+        for (size_t ii = 0; ii < left._magnitude.size(); ii++)
+        {
+            uint64_t carry = 0;
+            for (size_t jj = 0; jj < right._magnitude.size(); jj++)
+            {
+                uint64_t product = static_cast<uint64_t>(left._magnitude[ii]) * right._magnitude[jj] + result._magnitude[ii + jj] + carry;
+                result._magnitude[ii + jj] = static_cast<uint32_t>(product);
+                carry = product >> 32;
+            }
+            result._magnitude[ii + right._magnitude.size()] = static_cast<uint32_t>(carry);
+        }
+        result._negative = left._negative != right._negative;
+        result.trim();
+        return result;
+    }
+
+    // static
+    void BigInteger::divide(const BigInteger& dividend, const BigInteger& divisor, BigInteger& quotient, BigInteger& remainder)
+    {
+        BigInteger q, r;
+        if (divisor._magnitude.size() == 1)
+        {
+            q._magnitude = dividend._magnitude;
+            uint32_t rest = divideMagnitude(q._magnitude, divisor._magnitude[0]);
+            if (rest != 0)
+            {
+                r._magnitude.push_back(rest);
+            }
+        }
+        else
+        {
+            // binary long division, one dividend bit at a time
+            q._magnitude.assign(dividend._magnitude.size(), 0);
+            for (size_t bit = dividend._magnitude.size() * 32; bit > 0; bit--)
+            {
+                size_t limb = (bit - 1) / 32, shift = (bit - 1) % 32;
+
+                // r = r * 2 + the next dividend bit
+                uint32_t carry = (dividend._magnitude[limb] >> shift) & 1;
+                for (auto itr = r._magnitude.begin(); itr != r._magnitude.end(); itr++)
+                {
+                    uint32_t next = *itr >> 31;
+                    *itr = (*itr << 1) | carry;
+                    carry = next;
+                }
+                if (carry != 0)
+                {
+                    r._magnitude.push_back(carry);
+                }
+
+                if (compareMagnitude(r._magnitude, divisor._magnitude) >= 0)
+                {
+                    Limbs difference;
+                    subtractMagnitude(r._magnitude, divisor._magnitude, difference);
+                    r._magnitude.swap(difference);
+                    r.trim();
+                    q._magnitude[limb] |= 1u << shift;
+                }
+            }
+        }
+
+        q._negative = dividend._negative != divisor._negative;
+        r._negative = dividend._negative;
+        q.trim();
+        r.trim();
+        quotient = std::move(q);
+        remainder = std::move(r);
+    }
+
+    // static
+    int BigInteger::compareMagnitude(const Limbs& left, const Limbs& right)
+    {
+        if (left.size() != right.size())
+        {
+            return left.size() < right.size() ? -1 : 1;
+        }
+        for (size_t ii = left.size(); ii > 0; ii--)
+        {
+            if (left[ii - 1] != right[ii - 1])
+            {
+                return left[ii - 1] < right[ii - 1] ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+
+    // static
+    void BigInteger::addMagnitude(const Limbs& left, const Limbs& right, Limbs& result)
+    {
+        const Limbs& longer = left.size() >= right.size() ? left : right;
+        const Limbs& shorter = left.size() >= right.size() ? right : left;
+        result.assign(longer.size() + 1, 0);
+
+        uint64_t carry = 0;
+        for (size_t ii = 0; ii < longer.size(); ii++)
+        {
+            uint64_t sum = static_cast<uint64_t>(longer[ii]) + (ii < shorter.size() ? shorter[ii] : 0) + carry;
+            result[ii] = static_cast<uint32_t>(sum);
+            carry = sum >> 32;
+        }
+        result[longer.size()] = static_cast<uint32_t>(carry);
+    }
+
+    // static
+    void BigInteger::subtractMagnitude(const Limbs& left, const Limbs& right, Limbs& result)
+    {
+        result.assign(left.size(), 0);
+
+        int64_t borrow = 0;
+        for (size_t ii = 0; ii < left.size(); ii++)
+        {
+            int64_t difference = static_cast<int64_t>(left[ii]) - (ii < right.size() ? right[ii] : 0) - borrow;
+            borrow = difference < 0 ? 1 : 0;
+            result[ii] = static_cast<uint32_t>(difference + (borrow ? LIMB_BASE : 0));
+        }
+        while (!result.empty() && result.back() == 0)
+        {
+            result.pop_back();
+        }
+    }
+
+    // static
+    uint32_t BigInteger::divideMagnitude(Limbs& magnitude, uint32_t divisor)
+    {
+        uint64_t rest = 0;
+        for (size_t ii = magnitude.size(); ii > 0; ii--)
+        {
+            uint64_t current = (rest << 32) | magnitude[ii - 1];
+            magnitude[ii - 1] = static_cast<uint32_t>(current / divisor);
+            rest = current % divisor;
+        }
+        while (!magnitude.empty() && magnitude.back() == 0)
+        {
+            magnitude.pop_back();
+        }
+        return static_cast<uint32_t>(rest);
+    }
+
+    void BigInteger::trim()
+    {
+        while (!_magnitude.empty() && _magnitude.back() == 0)
+        {
+            _magnitude.pop_back();
+        }
+        if (_magnitude.empty())
+        {
+            _negative = false;
+        }
+    }
+}
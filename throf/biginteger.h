@@ -0,0 +1,58 @@
+#pragma once
+
+namespace throf
+{
+    // Arbitrary precision integer, where Number arithmetic goes when a result does not
+    // fit in 64 bits. Sign and magnitude, the magnitude in base 2^32 limbs, least
+    // significant first and without leading zero limbs; zero is never negative.
+    //
+    // Values are small in practice (a few limbs past int64), so the algorithms are the
+    // schoolbook ones.
+    class BigInteger
+    {
+    public:
+        typedef std::vector<uint32_t, ResourceAllocator<uint32_t>> Limbs;
+
+        explicit BigInteger(int64_t value = 0);
+
+        // a copy allocated through allocator
+        BigInteger(const BigInteger& other, const ResourceAllocator<uint32_t>& allocator);
+
+        // decimal digits with an optional sign; false if text is anything else
+        static bool parse(const std::string& text, BigInteger& result);
+
+        bool negative() const { return _negative; }
+        bool isZero() const { return _magnitude.empty(); }
+
+        bool fitsInt64() const;
+        int64_t toInt64() const;
+        double toDouble() const;
+        std::string toString() const;
+
+        // <0, 0 or >0 as left is less than, equal to or greater than right
+        static int compare(const BigInteger& left, const BigInteger& right);
+
+        static BigInteger add(const BigInteger& left, const BigInteger& right);
+        static BigInteger subtract(const BigInteger& left, const BigInteger& right);
+        static BigInteger multiply(const BigInteger& left, const BigInteger& right);
+
+        // Truncating division, like int64 / and %: the quotient rounds toward zero and
+        // the remainder takes the sign of the dividend. The divisor must not be zero.
+        static void divide(const BigInteger& dividend, const BigInteger& divisor, BigInteger& quotient, BigInteger& remainder);
+
+    private:
+        static int compareMagnitude(const Limbs& left, const Limbs& right);
+        static void addMagnitude(const Limbs& left, const Limbs& right, Limbs& result);
+
+        // left must not be smaller than right
+        static void subtractMagnitude(const Limbs& left, const Limbs& right, Limbs& result);
+
+        // divides magnitude in place by a single limb, returning the remainder
+        static uint32_t divideMagnitude(Limbs& magnitude, uint32_t divisor);
+
+        void trim();
+
+        bool _negative;
+        Limbs _magnitude;
+    };
+}
@@ -4,6 +4,13 @@
 #include <string>
 #include <map>
 
+// VS2013 (v120) has move semantics but not the noexcept keyword
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define THROF_NOEXCEPT throw()
+#else
+#define THROF_NOEXCEPT noexcept
+#endif
+
 namespace throf
 {
     using namespace std;
@@ -15,6 +22,7 @@ namespace throf
     const PRIMITIVE_WORD PRIM_ ## e = val; \
     const char* const PRIM_ ## e ## _STR = str \
 
+    op_code(STATS, -4, "stats");
     op_code(WORDS, -3, "words");
     op_code(CLS, -2, "cls");
     op_code(STACK, -1, "stack");
@@ -45,6 +53,83 @@ namespace throf
     op_code(OR, 24, "or");
     op_code(XOR, 25, "xor");
     op_code(DEFER, 26, ":defer");
+    op_code(SOCKETPAIR, 27, "socketpair");
+    op_code(PIPE, 28, "pipe");
+    op_code(TCP_LISTEN, 29, "tcp-listen");
+    op_code(TCP_CONNECT, 30, "tcp-connect");
+    op_code(UNIX_LISTEN, 31, "unix-listen");
+    op_code(UNIX_CONNECT, 32, "unix-connect");
+    op_code(LOCAL_PORT, 33, "local-port");
+    op_code(ON_ACCEPT, 34, "on-accept");
+    op_code(ON_READ, 35, "on-read");
+    op_code(ON_READ_LINE, 36, "on-read-line");
+    op_code(WRITE_ASYNC, 37, "write-async");
+    op_code(CLOSE, 38, "close");
+    op_code(RUN_LOOP, 39, "run-loop");
+    op_code(PRINT, 40, "print");
+    op_code(PROFILE_ON, 41, "profile-on");
+    op_code(PROFILE_OFF, 42, "profile-off");
+    op_code(PROFILE_REPORT, 43, "profile-report");
+    op_code(SAMPLE_ON, 44, "sample-on");
+    op_code(SAMPLE_OFF, 45, "sample-off");
+    op_code(SAMPLE_REPORT, 46, "sample-report");
+    op_code(TRACE_ON, 47, "trace-on");
+    op_code(TRACE_OFF, 48, "trace-off");
+    op_code(BENCH, 49, "bench");
+    op_code(GC, 50, "gc");
+    op_code(TIMES, 51, "times");
+    op_code(WHILE, 52, "while");
+    op_code(UNTIL, 53, "until");
+    op_code(EACH, 54, "each");
+    op_code(LOOP, 55, "loop");
+    op_code(CALL, 56, "call");
+    op_code(DIP, 57, "dip");
+    op_code(KEEP, 58, "keep");
+    op_code(BI, 59, "bi");
+    op_code(TRI, 60, "tri");
+    op_code(BI_AT, 61, "bi@");
+    op_code(CURRY, 62, "curry");
+    op_code(COMPOSE, 63, "compose");
+    op_code(TO_ARRAY, 64, ">array");
+    op_code(TO_DOUBLES, 65, ">doubles");
+    op_code(IOTA, 66, "iota");
+    op_code(VLENGTH, 67, "vlength");
+    op_code(VNTH, 68, "vnth");
+    op_code(VADD, 69, "v+");
+    op_code(VMUL, 70, "v*");
+    op_code(VSUM, 71, "vsum");
+    op_code(VDOT, 72, "vdot");
+    op_code(VMIN, 73, "vmin");
+    op_code(VMAX, 74, "vmax");
+    op_code(VMAP_AFFINE, 75, "vmap-affine");
+    op_code(SORT, 76, "sort");
+    op_code(SORT_BY, 77, "sort-by");
+    op_code(BINARY_SEARCH, 78, "binary-search");
+    op_code(PARTITION, 79, "partition");
+    op_code(UNIQUE, 80, "unique");
+    op_code(LENGTH, 81, "length");
+    op_code(CONCAT, 82, "concat");
+    op_code(SUBSEQ, 83, "subseq");
+    op_code(HEAD, 84, "head");
+    op_code(TAIL, 85, "tail");
+    op_code(FIND, 86, "find");
+    op_code(SPLIT, 87, "split");
+    op_code(JOIN, 88, "join");
+    op_code(NEW_HASHMAP, 89, "<hashmap>");
+    op_code(AT, 90, "at");
+    op_code(SET_AT, 91, "set-at");
+    op_code(DELETE_AT, 92, "delete-at");
+    op_code(KEYS, 93, "keys");
+    op_code(EACH_ENTRY, 94, "each-entry");
+    op_code(TUPLE, 95, ":tuple");
+    op_code(NEW_TUPLE, 96, "<tuple>");
+    op_code(IS_TUPLE, 97, "tuple?");
+    op_code(SLOT_GET, 98, "slot>>");
+    op_code(SLOT_SET, 99, ">>slot");
+    op_code(BIND_LOCALS, 100, "bind-locals");
+    op_code(LOCAL, 101, "local@");
+    op_code(CONSTANT, 102, ":constant");
+    op_code(CAPTURE_LOCALS, 103, "capture-locals");
 
 
 #undef op_code
@@ -52,6 +137,7 @@ namespace throf
     static unordered_map<string, PRIMITIVE_WORD> createStrToPrimMap()
     {
         unordered_map<string, PRIMITIVE_WORD> ret;
+        ret[PRIM_STATS_STR]     = PRIM_STATS    ;
         ret[PRIM_WORDS_STR]     = PRIM_WORDS    ;
         ret[PRIM_CLS_STR]       = PRIM_CLS      ;
         ret[PRIM_STACK_STR]     = PRIM_STACK    ;
@@ -82,6 +168,83 @@ namespace throf
         ret[PRIM_OR_STR]        = PRIM_OR       ;
         ret[PRIM_XOR_STR]       = PRIM_XOR      ;
         ret[PRIM_DEFER_STR]     = PRIM_DEFER    ;
+        ret[PRIM_SOCKETPAIR_STR] = PRIM_SOCKETPAIR ;
+        ret[PRIM_PIPE_STR]      = PRIM_PIPE     ;
+        ret[PRIM_TCP_LISTEN_STR] = PRIM_TCP_LISTEN ;
+        ret[PRIM_TCP_CONNECT_STR] = PRIM_TCP_CONNECT ;
+        ret[PRIM_UNIX_LISTEN_STR] = PRIM_UNIX_LISTEN ;
+        ret[PRIM_UNIX_CONNECT_STR] = PRIM_UNIX_CONNECT ;
+        ret[PRIM_LOCAL_PORT_STR] = PRIM_LOCAL_PORT ;
+        ret[PRIM_ON_ACCEPT_STR] = PRIM_ON_ACCEPT ;
+        ret[PRIM_ON_READ_STR]   = PRIM_ON_READ  ;
+        ret[PRIM_ON_READ_LINE_STR] = PRIM_ON_READ_LINE ;
+        ret[PRIM_WRITE_ASYNC_STR] = PRIM_WRITE_ASYNC ;
+        ret[PRIM_CLOSE_STR]     = PRIM_CLOSE    ;
+        ret[PRIM_RUN_LOOP_STR]  = PRIM_RUN_LOOP ;
+        ret[PRIM_PRINT_STR]     = PRIM_PRINT    ;
+        ret[PRIM_PROFILE_ON_STR] = PRIM_PROFILE_ON ;
+        ret[PRIM_PROFILE_OFF_STR] = PRIM_PROFILE_OFF ;
+        ret[PRIM_PROFILE_REPORT_STR] = PRIM_PROFILE_REPORT ;
+        ret[PRIM_SAMPLE_ON_STR] = PRIM_SAMPLE_ON ;
+        ret[PRIM_SAMPLE_OFF_STR] = PRIM_SAMPLE_OFF ;
+        ret[PRIM_SAMPLE_REPORT_STR] = PRIM_SAMPLE_REPORT ;
+        ret[PRIM_TRACE_ON_STR]  = PRIM_TRACE_ON ;
+        ret[PRIM_TRACE_OFF_STR] = PRIM_TRACE_OFF ;
+        ret[PRIM_BENCH_STR]     = PRIM_BENCH    ;
+        ret[PRIM_GC_STR]        = PRIM_GC       ;
+        ret[PRIM_TIMES_STR]     = PRIM_TIMES    ;
+        ret[PRIM_WHILE_STR]     = PRIM_WHILE    ;
+        ret[PRIM_UNTIL_STR]     = PRIM_UNTIL    ;
+        ret[PRIM_EACH_STR]      = PRIM_EACH     ;
+        ret[PRIM_LOOP_STR]      = PRIM_LOOP     ;
+        ret[PRIM_CALL_STR]      = PRIM_CALL     ;
+        ret[PRIM_DIP_STR]       = PRIM_DIP      ;
+        ret[PRIM_KEEP_STR]      = PRIM_KEEP     ;
+        ret[PRIM_BI_STR]        = PRIM_BI       ;
+        ret[PRIM_TRI_STR]       = PRIM_TRI      ;
+        ret[PRIM_BI_AT_STR]     = PRIM_BI_AT    ;
+        ret[PRIM_CURRY_STR]     = PRIM_CURRY    ;
+        ret[PRIM_COMPOSE_STR]   = PRIM_COMPOSE  ;
+        ret[PRIM_TO_ARRAY_STR]  = PRIM_TO_ARRAY ;
+        ret[PRIM_TO_DOUBLES_STR] = PRIM_TO_DOUBLES ;
+        ret[PRIM_IOTA_STR]      = PRIM_IOTA     ;
+        ret[PRIM_VLENGTH_STR]   = PRIM_VLENGTH  ;
+        ret[PRIM_VNTH_STR]      = PRIM_VNTH     ;
+        ret[PRIM_VADD_STR]      = PRIM_VADD     ;
+        ret[PRIM_VMUL_STR]      = PRIM_VMUL     ;
+        ret[PRIM_VSUM_STR]      = PRIM_VSUM     ;
+        ret[PRIM_VDOT_STR]      = PRIM_VDOT     ;
+        ret[PRIM_VMIN_STR]      = PRIM_VMIN     ;
+        ret[PRIM_VMAX_STR]      = PRIM_VMAX     ;
+        ret[PRIM_VMAP_AFFINE_STR] = PRIM_VMAP_AFFINE ;
+        ret[PRIM_SORT_STR]      = PRIM_SORT     ;
+        ret[PRIM_SORT_BY_STR]   = PRIM_SORT_BY  ;
+        ret[PRIM_BINARY_SEARCH_STR] = PRIM_BINARY_SEARCH ;
+        ret[PRIM_PARTITION_STR] = PRIM_PARTITION ;
+        ret[PRIM_UNIQUE_STR]    = PRIM_UNIQUE   ;
+        ret[PRIM_LENGTH_STR]    = PRIM_LENGTH   ;
+        ret[PRIM_CONCAT_STR]    = PRIM_CONCAT   ;
+        ret[PRIM_SUBSEQ_STR]    = PRIM_SUBSEQ   ;
+        ret[PRIM_HEAD_STR]      = PRIM_HEAD     ;
+        ret[PRIM_TAIL_STR]      = PRIM_TAIL     ;
+        ret[PRIM_FIND_STR]      = PRIM_FIND     ;
+        ret[PRIM_SPLIT_STR]     = PRIM_SPLIT    ;
+        ret[PRIM_JOIN_STR]      = PRIM_JOIN     ;
+        ret[PRIM_NEW_HASHMAP_STR] = PRIM_NEW_HASHMAP ;
+        ret[PRIM_AT_STR]        = PRIM_AT       ;
+        ret[PRIM_SET_AT_STR]    = PRIM_SET_AT   ;
+        ret[PRIM_DELETE_AT_STR] = PRIM_DELETE_AT ;
+        ret[PRIM_KEYS_STR]      = PRIM_KEYS     ;
+        ret[PRIM_EACH_ENTRY_STR] = PRIM_EACH_ENTRY ;
+        ret[PRIM_TUPLE_STR]     = PRIM_TUPLE    ;
+        ret[PRIM_NEW_TUPLE_STR] = PRIM_NEW_TUPLE ;
+        ret[PRIM_IS_TUPLE_STR]  = PRIM_IS_TUPLE ;
+        ret[PRIM_SLOT_GET_STR]  = PRIM_SLOT_GET ;
+        ret[PRIM_SLOT_SET_STR]  = PRIM_SLOT_SET ;
+        ret[PRIM_BIND_LOCALS_STR] = PRIM_BIND_LOCALS ;
+        ret[PRIM_LOCAL_STR]     = PRIM_LOCAL    ;
+        ret[PRIM_CONSTANT_STR]  = PRIM_CONSTANT ;
+        ret[PRIM_CAPTURE_LOCALS_STR] = PRIM_CAPTURE_LOCALS ;
 
         return ret;
     }
@@ -89,6 +252,7 @@ namespace throf
     static unordered_map<PRIMITIVE_WORD, string> createPrimToStrMap()
     {
         unordered_map<PRIMITIVE_WORD, string> ret;
+        ret[PRIM_STATS]     = PRIM_STATS_STR    ;
         ret[PRIM_WORDS]     = PRIM_WORDS_STR    ;
         ret[PRIM_CLS]       = PRIM_CLS_STR      ;
         ret[PRIM_STACK]     = PRIM_STACK_STR    ;
@@ -119,6 +283,83 @@ namespace throf
         ret[PRIM_OR]        = PRIM_OR_STR       ;
         ret[PRIM_XOR]       = PRIM_XOR_STR      ;
         ret[PRIM_DEFER]     = PRIM_DEFER_STR    ;
+        ret[PRIM_SOCKETPAIR] = PRIM_SOCKETPAIR_STR ;
+        ret[PRIM_PIPE]      = PRIM_PIPE_STR     ;
+        ret[PRIM_TCP_LISTEN] = PRIM_TCP_LISTEN_STR ;
+        ret[PRIM_TCP_CONNECT] = PRIM_TCP_CONNECT_STR ;
+        ret[PRIM_UNIX_LISTEN] = PRIM_UNIX_LISTEN_STR ;
+        ret[PRIM_UNIX_CONNECT] = PRIM_UNIX_CONNECT_STR ;
+        ret[PRIM_LOCAL_PORT] = PRIM_LOCAL_PORT_STR ;
+        ret[PRIM_ON_ACCEPT] = PRIM_ON_ACCEPT_STR ;
+        ret[PRIM_ON_READ]   = PRIM_ON_READ_STR  ;
+        ret[PRIM_ON_READ_LINE] = PRIM_ON_READ_LINE_STR ;
+        ret[PRIM_WRITE_ASYNC] = PRIM_WRITE_ASYNC_STR ;
+        ret[PRIM_CLOSE]     = PRIM_CLOSE_STR    ;
+        ret[PRIM_RUN_LOOP]  = PRIM_RUN_LOOP_STR ;
+        ret[PRIM_PRINT]     = PRIM_PRINT_STR    ;
+        ret[PRIM_PROFILE_ON] = PRIM_PROFILE_ON_STR ;
+        ret[PRIM_PROFILE_OFF] = PRIM_PROFILE_OFF_STR ;
+        ret[PRIM_PROFILE_REPORT] = PRIM_PROFILE_REPORT_STR ;
+        ret[PRIM_SAMPLE_ON] = PRIM_SAMPLE_ON_STR ;
+        ret[PRIM_SAMPLE_OFF] = PRIM_SAMPLE_OFF_STR ;
+        ret[PRIM_SAMPLE_REPORT] = PRIM_SAMPLE_REPORT_STR ;
+        ret[PRIM_TRACE_ON]  = PRIM_TRACE_ON_STR ;
+        ret[PRIM_TRACE_OFF] = PRIM_TRACE_OFF_STR ;
+        ret[PRIM_BENCH]     = PRIM_BENCH_STR    ;
+        ret[PRIM_GC]        = PRIM_GC_STR       ;
+        ret[PRIM_TIMES]     = PRIM_TIMES_STR    ;
+        ret[PRIM_WHILE]     = PRIM_WHILE_STR    ;
+        ret[PRIM_UNTIL]     = PRIM_UNTIL_STR    ;
+        ret[PRIM_EACH]      = PRIM_EACH_STR     ;
+        ret[PRIM_LOOP]      = PRIM_LOOP_STR     ;
+        ret[PRIM_CALL]      = PRIM_CALL_STR     ;
+        ret[PRIM_DIP]       = PRIM_DIP_STR      ;
+        ret[PRIM_KEEP]      = PRIM_KEEP_STR     ;
+        ret[PRIM_BI]        = PRIM_BI_STR       ;
+        ret[PRIM_TRI]       = PRIM_TRI_STR      ;
+        ret[PRIM_BI_AT]     = PRIM_BI_AT_STR    ;
+        ret[PRIM_CURRY]     = PRIM_CURRY_STR    ;
+        ret[PRIM_COMPOSE]   = PRIM_COMPOSE_STR  ;
+        ret[PRIM_TO_ARRAY]  = PRIM_TO_ARRAY_STR ;
+        ret[PRIM_TO_DOUBLES] = PRIM_TO_DOUBLES_STR ;
+        ret[PRIM_IOTA]      = PRIM_IOTA_STR     ;
+        ret[PRIM_VLENGTH]   = PRIM_VLENGTH_STR  ;
+        ret[PRIM_VNTH]      = PRIM_VNTH_STR     ;
+        ret[PRIM_VADD]      = PRIM_VADD_STR     ;
+        ret[PRIM_VMUL]      = PRIM_VMUL_STR     ;
+        ret[PRIM_VSUM]      = PRIM_VSUM_STR     ;
+        ret[PRIM_VDOT]      = PRIM_VDOT_STR     ;
+        ret[PRIM_VMIN]      = PRIM_VMIN_STR     ;
+        ret[PRIM_VMAX]      = PRIM_VMAX_STR     ;
+        ret[PRIM_VMAP_AFFINE] = PRIM_VMAP_AFFINE_STR ;
+        ret[PRIM_SORT]      = PRIM_SORT_STR     ;
+        ret[PRIM_SORT_BY]   = PRIM_SORT_BY_STR  ;
+        ret[PRIM_BINARY_SEARCH] = PRIM_BINARY_SEARCH_STR ;
+        ret[PRIM_PARTITION] = PRIM_PARTITION_STR ;
+        ret[PRIM_UNIQUE]    = PRIM_UNIQUE_STR   ;
+        ret[PRIM_LENGTH]    = PRIM_LENGTH_STR   ;
+        ret[PRIM_CONCAT]    = PRIM_CONCAT_STR   ;
+        ret[PRIM_SUBSEQ]    = PRIM_SUBSEQ_STR   ;
+        ret[PRIM_HEAD]      = PRIM_HEAD_STR     ;
+        ret[PRIM_TAIL]      = PRIM_TAIL_STR     ;
+        ret[PRIM_FIND]      = PRIM_FIND_STR     ;
+        ret[PRIM_SPLIT]     = PRIM_SPLIT_STR    ;
+        ret[PRIM_JOIN]      = PRIM_JOIN_STR     ;
+        ret[PRIM_NEW_HASHMAP] = PRIM_NEW_HASHMAP_STR ;
+        ret[PRIM_AT]        = PRIM_AT_STR       ;
+        ret[PRIM_SET_AT]    = PRIM_SET_AT_STR   ;
+        ret[PRIM_DELETE_AT] = PRIM_DELETE_AT_STR ;
+        ret[PRIM_KEYS]      = PRIM_KEYS_STR     ;
+        ret[PRIM_EACH_ENTRY] = PRIM_EACH_ENTRY_STR ;
+        ret[PRIM_TUPLE]     = PRIM_TUPLE_STR    ;
+        ret[PRIM_NEW_TUPLE] = PRIM_NEW_TUPLE_STR ;
+        ret[PRIM_IS_TUPLE]  = PRIM_IS_TUPLE_STR ;
+        ret[PRIM_SLOT_GET]  = PRIM_SLOT_GET_STR ;
+        ret[PRIM_SLOT_SET]  = PRIM_SLOT_SET_STR ;
+        ret[PRIM_BIND_LOCALS] = PRIM_BIND_LOCALS_STR ;
+        ret[PRIM_LOCAL]     = PRIM_LOCAL_STR    ;
+        ret[PRIM_CONSTANT]  = PRIM_CONSTANT_STR ;
+        ret[PRIM_CAPTURE_LOCALS] = PRIM_CAPTURE_LOCALS_STR ;
         return ret;
     }
 
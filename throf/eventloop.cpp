@@ -0,0 +1,689 @@
+#include "stdafx.h"
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+namespace throf
+{
+    using namespace std;
+
+    static const unsigned int EVENT_READABLE = 1;
+    static const unsigned int EVENT_WRITABLE = 2;
+    static const unsigned int EVENT_ERROR = 4;
+
+    static const size_t READ_CHUNK_SIZE = 65536;
+
+    static void throwErrno(const char* call)
+    {
+        stringstream strBuilder;
+        strBuilder << call << " failed, errno = " << errno;
+        throw ThrofException("EventLoop", strBuilder.str());
+    }
+
+    bool FdReader::fill(int fd)
+    {
+        // compact what has already been consumed before growing the buffer
+        if (_index > 0)
+        {
+            _buffer.erase(_buffer.begin(), _buffer.begin() + _index);
+            _index = 0;
+        }
+
+        for (;;)
+        {
+            size_t used = _buffer.size();
+            _buffer.resize(used + READ_CHUNK_SIZE);
+            ssize_t count = ::read(fd, &_buffer[used], READ_CHUNK_SIZE);
+            _buffer.resize(used + (count > 0 ? count : 0));
+
+            if (count > 0)
+            {
+                continue;
+            }
+            else if (count == 0)
+            {
+                _eof = true;
+                return true;
+            }
+            else if (errno == EINTR)
+            {
+                continue;
+            }
+
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+
+    bool FdReader::getLine(string& line)
+    {
+        const char* begin = _buffer.data() + _index;
+        const char* end = _buffer.data() + _buffer.size();
+        const char* newline = static_cast<const char*>(memchr(begin, '\n', end - begin));
+
+        if (nullptr == newline)
+        {
+            // a final unterminated line is still a line once the peer is done
+            return _eof && getAll(line);
+        }
+
+        line.assign(begin, newline);
+        _index += (newline - begin) + 1;
+        return true;
+    }
+
+    bool FdReader::getAll(string& data)
+    {
+        if (available() == 0)
+        {
+            return false;
+        }
+
+        data.assign(_buffer.data() + _index, available());
+        _buffer.clear();
+        _index = 0;
+        return true;
+    }
+
+    EventLoop::EventLoop() : _pollFd(-1), _initialized(false)
+    {
+    }
+
+    EventLoop::~EventLoop()
+    {
+        for (auto itr = _fds.begin(); itr != _fds.end(); itr++)
+        {
+            ::close((*itr).first);
+        }
+
+        if (_pollFd >= 0)
+        {
+            ::close(_pollFd);
+        }
+    }
+
+    // The poller is only created once a script actually touches a descriptor, so
+    // interpreters that never do I/O don't pay for it.
+    void EventLoop::initialize()
+    {
+        if (_initialized)
+        {
+            return;
+        }
+
+        // a peer hanging up must surface as a failed write, not kill the process
+        signal(SIGPIPE, SIG_IGN);
+
+#ifdef __linux__
+        _pollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (_pollFd < 0)
+        {
+            throwErrno("epoll_create1");
+        }
+#endif
+        _initialized = true;
+    }
+
+    int EventLoop::adopt(int fd)
+    {
+        int flags = fcntl(fd, F_GETFL, 0);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        {
+            ::close(fd);
+            throwErrno("fcntl");
+        }
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        _fds[fd] = FdState();
+        return fd;
+    }
+
+    EventLoop::FdState& EventLoop::stateFor(int fd)
+    {
+        auto itr = _fds.find(fd);
+        if (itr == _fds.end())
+        {
+            stringstream strBuilder;
+            strBuilder << "file descriptor " << fd << " is not managed by the event loop";
+            throw ThrofException("EventLoop", strBuilder.str());
+        }
+        return (*itr).second;
+    }
+
+    int EventLoop::listenTcp(int port)
+    {
+        initialize();
+
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            throwErrno("socket");
+        }
+
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0)
+        {
+            ::close(fd);
+            throwErrno("bind/listen");
+        }
+
+        return adopt(fd);
+    }
+
+    int EventLoop::connectTcp(int port)
+    {
+        initialize();
+
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            throwErrno("socket");
+        }
+        adopt(fd);
+
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        // the connect finishes in the background; queued writes wait for it
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 && errno != EINPROGRESS)
+        {
+            close(fd);
+            throwErrno("connect");
+        }
+
+        return fd;
+    }
+
+    static sockaddr_un unixAddress(const string& path)
+    {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+
+        if (path.size() >= sizeof(addr.sun_path))
+        {
+            throw ThrofException("EventLoop", "unix socket path is too long : " + path);
+        }
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        return addr;
+    }
+
+    int EventLoop::listenUnix(const string& path)
+    {
+        initialize();
+
+        sockaddr_un addr = unixAddress(path);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            throwErrno("socket");
+        }
+
+        unlink(path.c_str());
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0)
+        {
+            ::close(fd);
+            throwErrno("bind/listen");
+        }
+
+        return adopt(fd);
+    }
+
+    int EventLoop::connectUnix(const string& path)
+    {
+        initialize();
+
+        sockaddr_un addr = unixAddress(path);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            throwErrno("socket");
+        }
+
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+        {
+            ::close(fd);
+            throwErrno("connect");
+        }
+
+        return adopt(fd);
+    }
+
+    void EventLoop::createSocketPair(int& first, int& second)
+    {
+        initialize();
+
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        {
+            throwErrno("socketpair");
+        }
+
+        first = adopt(fds[0]);
+        second = adopt(fds[1]);
+    }
+
+    void EventLoop::createPipe(int& readEnd, int& writeEnd)
+    {
+        initialize();
+
+        int fds[2];
+        if (::pipe(fds) < 0)
+        {
+            throwErrno("pipe");
+        }
+
+        readEnd = adopt(fds[0]);
+        writeEnd = adopt(fds[1]);
+    }
+
+    int EventLoop::localPort(int fd)
+    {
+        stateFor(fd);
+
+        sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        if (getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len) < 0)
+        {
+            throwErrno("getsockname");
+        }
+        return ntohs(addr.sin_port);
+    }
+
+    void EventLoop::close(int fd)
+    {
+        FdState& state = stateFor(fd);
+
+#ifdef __linux__
+        if (state.registeredEvents != 0)
+        {
+            epoll_ctl(_pollFd, EPOLL_CTL_DEL, fd, nullptr);
+        }
+#else
+        UNREFERENCED_PARAMETER(state);
+#endif
+
+        _fds.erase(fd);
+        ::close(fd);
+    }
+
+    void EventLoop::addRead(int fd, const StackElement& quotation, bool wholeLine)
+    {
+        FdState& state = stateFor(fd);
+        ThrofException::throwIfTrue(state.hasRead || state.hasAccept, "EventLoop",
+            "a read or accept is already pending on this file descriptor");
+
+        state.hasRead = true;
+        state.readWholeLine = wholeLine;
+        state.readQuotation = quotation;
+        updateInterest(fd, state);
+    }
+
+    void EventLoop::addWrite(int fd, const string& data, const StackElement& quotation)
+    {
+        FdState& state = stateFor(fd);
+
+        PendingWrite write;
+        write.data = data;
+        write.offset = 0;
+        write.quotation = quotation;
+        state.writes.push_back(write);
+        updateInterest(fd, state);
+    }
+
+    void EventLoop::addAccept(int fd, const StackElement& quotation)
+    {
+        FdState& state = stateFor(fd);
+        ThrofException::throwIfTrue(state.hasRead || state.hasAccept, "EventLoop",
+            "a read or accept is already pending on this file descriptor");
+
+        state.hasAccept = true;
+        state.acceptQuotation = quotation;
+        updateInterest(fd, state);
+    }
+
+    bool EventLoop::hasPending() const
+    {
+        for (auto itr = _fds.cbegin(); itr != _fds.cend(); itr++)
+        {
+            const FdState& state = (*itr).second;
+            if (state.hasRead || state.hasAccept || !state.writes.empty())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void EventLoop::pendingQuotations(vector<StackElement*>& quotations)
+    {
+        for (auto itr = _fds.begin(); itr != _fds.end(); itr++)
+        {
+            FdState& state = (*itr).second;
+            if (state.hasRead)
+            {
+                quotations.push_back(&state.readQuotation);
+            }
+            if (state.hasAccept)
+            {
+                quotations.push_back(&state.acceptQuotation);
+            }
+            for (auto jtr = state.writes.begin(); jtr != state.writes.end(); jtr++)
+            {
+                quotations.push_back(&(*jtr).quotation);
+            }
+        }
+    }
+
+    void EventLoop::updateInterest(int fd, FdState& state)
+    {
+        unsigned int wanted = 0;
+        if (state.hasAccept || (state.hasRead && !state.reader.eof()))
+        {
+            wanted |= EVENT_READABLE;
+        }
+        if (!state.writes.empty())
+        {
+            wanted |= EVENT_WRITABLE;
+        }
+
+        if (wanted == state.registeredEvents)
+        {
+            return;
+        }
+
+#ifdef __linux__
+        epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.data.fd = fd;
+        ev.events = ((wanted & EVENT_READABLE) ? EPOLLIN : 0) | ((wanted & EVENT_WRITABLE) ? EPOLLOUT : 0);
+
+        int op = (state.registeredEvents == 0) ? EPOLL_CTL_ADD : (wanted == 0 ? EPOLL_CTL_DEL : EPOLL_CTL_MOD);
+        if (epoll_ctl(_pollFd, op, fd, &ev) < 0)
+        {
+            throwErrno("epoll_ctl");
+        }
+#endif
+        state.registeredEvents = wanted;
+    }
+
+    void EventLoop::waitForEvents(vector<pair<int, unsigned int>>& ready, int timeoutMs)
+    {
+#ifdef __linux__
+        static const int MAX_EVENTS = 256;
+        epoll_event events[MAX_EVENTS];
+
+        int count = epoll_wait(_pollFd, events, MAX_EVENTS, timeoutMs);
+        if (count < 0 && errno != EINTR)
+        {
+            throwErrno("epoll_wait");
+        }
+
+        for (int ii = 0; ii < count; ii++)
+        {
+            unsigned int flags = 0;
+            flags |= (events[ii].events & (EPOLLIN | EPOLLHUP)) ? EVENT_READABLE : 0;
+            flags |= (events[ii].events & EPOLLOUT) ? EVENT_WRITABLE : 0;
+            flags |= (events[ii].events & EPOLLERR) ? EVENT_ERROR : 0;
+            int readyFd = events[ii].data.fd;
+            ready.push_back(make_pair(readyFd, flags));
+        }
+#else
+        vector<pollfd> pollFds;
+        for (auto itr = _fds.cbegin(); itr != _fds.cend(); itr++)
+        {
+            unsigned int wanted = (*itr).second.registeredEvents;
+            if (wanted != 0)
+            {
+                pollfd p;
+                p.fd = (*itr).first;
+                p.events = ((wanted & EVENT_READABLE) ? POLLIN : 0) | ((wanted & EVENT_WRITABLE) ? POLLOUT : 0);
+                p.revents = 0;
+                pollFds.push_back(p);
+            }
+        }
+
+        int count = ::poll(pollFds.data(), pollFds.size(), timeoutMs);
+        if (count < 0 && errno != EINTR)
+        {
+            throwErrno("poll");
+        }
+
+        for (size_t ii = 0; count > 0 && ii < pollFds.size(); ii++)
+        {
+            unsigned int flags = 0;
+            flags |= (pollFds[ii].revents & (POLLIN | POLLHUP)) ? EVENT_READABLE : 0;
+            flags |= (pollFds[ii].revents & POLLOUT) ? EVENT_WRITABLE : 0;
+            flags |= (pollFds[ii].revents & (POLLERR | POLLNVAL)) ? EVENT_ERROR : 0;
+            if (flags != 0)
+            {
+                ready.push_back(make_pair(pollFds[ii].fd, flags));
+            }
+        }
+#endif
+    }
+
+    bool EventLoop::completeBufferedRead(int fd, FdState& state, vector<Completion>& completions)
+    {
+        Completion completion;
+        completion.type = state.readWholeLine ? ReadLine : Read;
+        completion.fd = fd;
+
+        bool haveData = state.readWholeLine ? state.reader.getLine(completion.data) : state.reader.getAll(completion.data);
+        if (!haveData && !state.reader.eof())
+        {
+            return false;
+        }
+
+        // at end of stream the quotation still runs, with an empty string and 'false'
+        completion.success = haveData;
+        completion.quotation = state.readQuotation;
+        state.hasRead = false;
+        state.readQuotation = StackElement();
+        completions.push_back(completion);
+        return true;
+    }
+
+    void EventLoop::handleReadable(int fd, FdState& state, vector<Completion>& completions)
+    {
+        if (state.hasAccept)
+        {
+            int client = accept(fd, nullptr, nullptr);
+            if (client < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                {
+                    return;
+                }
+                throwErrno("accept");
+            }
+
+            Completion completion;
+            completion.type = Accept;
+            completion.fd = adopt(client);
+            completion.success = true;
+            completion.quotation = state.acceptQuotation;
+            state.hasAccept = false;
+            state.acceptQuotation = StackElement();
+            completions.push_back(completion);
+            return;
+        }
+
+        if (state.hasRead)
+        {
+            if (!state.reader.fill(fd))
+            {
+                handleError(fd, state, completions);
+                return;
+            }
+            completeBufferedRead(fd, state, completions);
+        }
+    }
+
+    void EventLoop::handleWritable(int fd, FdState& state, vector<Completion>& completions)
+    {
+        while (!state.writes.empty())
+        {
+            PendingWrite& write = state.writes.front();
+            while (write.offset < write.data.size())
+            {
+                ssize_t count = ::write(fd, write.data.data() + write.offset, write.data.size() - write.offset);
+                if (count < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    {
+                        return;
+                    }
+                    handleError(fd, state, completions);
+                    return;
+                }
+                write.offset += count;
+            }
+
+            Completion completion;
+            completion.type = Write;
+            completion.fd = fd;
+            completion.success = true;
+            completion.quotation = write.quotation;
+            completions.push_back(completion);
+            state.writes.erase(state.writes.begin());
+        }
+    }
+
+    // Fails every outstanding operation on the descriptor; the quotations still run
+    // so the script gets a chance to close it.
+    void EventLoop::handleError(int fd, FdState& state, vector<Completion>& completions)
+    {
+        for (auto itr = state.writes.begin(); itr != state.writes.end(); itr++)
+        {
+            Completion completion;
+            completion.type = Write;
+            completion.fd = fd;
+            completion.success = false;
+            completion.quotation = (*itr).quotation;
+            completions.push_back(completion);
+        }
+        state.writes.clear();
+
+        if (state.hasRead)
+        {
+            Completion completion;
+            completion.type = state.readWholeLine ? ReadLine : Read;
+            completion.fd = fd;
+            completion.success = false;
+            completion.quotation = state.readQuotation;
+            completions.push_back(completion);
+            state.hasRead = false;
+            state.readQuotation = StackElement();
+        }
+    }
+
+    void EventLoop::poll(vector<Completion>& completions)
+    {
+        // reads that can be satisfied from what is already buffered finish first
+        for (auto itr = _fds.begin(); itr != _fds.end(); itr++)
+        {
+            FdState& state = (*itr).second;
+            if (state.hasRead)
+            {
+                completeBufferedRead((*itr).first, state, completions);
+                updateInterest((*itr).first, state);
+            }
+        }
+
+        if (!completions.empty() || !hasPending())
+        {
+            return;
+        }
+
+        vector<pair<int, unsigned int>> ready;
+        waitForEvents(ready, -1);
+
+        for (auto itr = ready.begin(); itr != ready.end(); itr++)
+        {
+            int fd = (*itr).first;
+            unsigned int flags = (*itr).second;
+
+            auto stateItr = _fds.find(fd);
+            if (stateItr == _fds.end())
+            {
+                continue;
+            }
+            FdState& state = (*stateItr).second;
+
+            // on an error condition let the read/write itself report what went wrong
+            if (flags & (EVENT_WRITABLE | EVENT_ERROR))
+            {
+                handleWritable(fd, state, completions);
+            }
+            if (flags & (EVENT_READABLE | EVENT_ERROR))
+            {
+                handleReadable(fd, state, completions);
+            }
+
+            // accepted clients were added to _fds; look the state up again
+            updateInterest(fd, _fds[fd]);
+        }
+    }
+}
+
+#else
+
+namespace throf
+{
+    static void throwUnsupported()
+    {
+        throw ThrofException("EventLoop", "event loop words are not supported on this platform");
+    }
+
+    bool FdReader::fill(int) { throwUnsupported(); return false; }
+    bool FdReader::getLine(std::string&) { throwUnsupported(); return false; }
+    bool FdReader::getAll(std::string&) { throwUnsupported(); return false; }
+
+    EventLoop::EventLoop() : _pollFd(-1), _initialized(false) { }
+    EventLoop::~EventLoop() { }
+
+    int EventLoop::listenTcp(int) { throwUnsupported(); return -1; }
+    int EventLoop::connectTcp(int) { throwUnsupported(); return -1; }
+    int EventLoop::listenUnix(const std::string&) { throwUnsupported(); return -1; }
+    int EventLoop::connectUnix(const std::string&) { throwUnsupported(); return -1; }
+    void EventLoop::createSocketPair(int&, int&) { throwUnsupported(); }
+    void EventLoop::createPipe(int&, int&) { throwUnsupported(); }
+    int EventLoop::localPort(int) { throwUnsupported(); return -1; }
+    void EventLoop::close(int) { throwUnsupported(); }
+    void EventLoop::addRead(int, const StackElement&, bool) { throwUnsupported(); }
+    void EventLoop::addWrite(int, const std::string&, const StackElement&) { throwUnsupported(); }
+    void EventLoop::addAccept(int, const StackElement&) { throwUnsupported(); }
+    bool EventLoop::hasPending() const { return false; }
+    void EventLoop::pendingQuotations(std::vector<StackElement*>&) { }
+    void EventLoop::poll(std::vector<Completion>&) { throwUnsupported(); }
+}
+
+#endif
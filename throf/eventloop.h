@@ -0,0 +1,119 @@
+#pragma once
+
+namespace throf
+{
+    // Buffered, non-blocking reader over a file descriptor. Mirrors InputReader: the
+    // bytes land in _buffer and are consumed from _index onwards, but the buffer is
+    // refilled from the descriptor whenever the event loop sees it become readable.
+    class FdReader
+    {
+        std::vector<char> _buffer;
+        size_t _index;
+        bool _eof;
+
+    public:
+        FdReader() : _index(0), _eof(false) { }
+
+        // Reads until the descriptor would block. Returns false on a read error.
+        bool fill(int fd);
+
+        bool getLine(std::string& line);
+        bool getAll(std::string& data);
+
+        const bool eof() const
+        {
+            return _eof;
+        }
+
+        const size_t available() const
+        {
+            return _buffer.size() - _index;
+        }
+    };
+
+    class EventLoop
+    {
+    public:
+        enum OperationType
+        {
+            Read,
+            ReadLine,
+            Write,
+            Accept
+        };
+
+        // A finished operation, handed back to the interpreter which pushes the
+        // results and resumes the quotation.
+        struct Completion
+        {
+            OperationType type;
+            StackElement quotation;
+            std::string data;
+            int fd;
+            bool success;
+        };
+
+        EventLoop();
+        ~EventLoop();
+
+        int listenTcp(int port);
+        int connectTcp(int port);
+        int listenUnix(const std::string& path);
+        int connectUnix(const std::string& path);
+        void createSocketPair(int& first, int& second);
+        void createPipe(int& readEnd, int& writeEnd);
+        int localPort(int fd);
+        void close(int fd);
+
+        void addRead(int fd, const StackElement& quotation, bool wholeLine);
+        void addWrite(int fd, const std::string& data, const StackElement& quotation);
+        void addAccept(int fd, const StackElement& quotation);
+
+        bool hasPending() const;
+
+        // the quotations waiting on completions, for the interpreter's gc roots
+        void pendingQuotations(std::vector<StackElement*>& quotations);
+
+        // Blocks until at least one operation completes.
+        void poll(std::vector<Completion>& completions);
+
+    private:
+        struct PendingWrite
+        {
+            std::string data;
+            size_t offset;
+            StackElement quotation;
+        };
+
+        struct FdState
+        {
+            FdReader reader;
+            bool hasRead;
+            bool readWholeLine;
+            StackElement readQuotation;
+            bool hasAccept;
+            StackElement acceptQuotation;
+            std::vector<PendingWrite> writes;
+            unsigned int registeredEvents;
+
+            FdState() : hasRead(false), readWholeLine(false), hasAccept(false), registeredEvents(0) { }
+        };
+
+        void initialize();
+        int adopt(int fd);
+        FdState& stateFor(int fd);
+        void updateInterest(int fd, FdState& state);
+        bool completeBufferedRead(int fd, FdState& state, std::vector<Completion>& completions);
+        void handleReadable(int fd, FdState& state, std::vector<Completion>& completions);
+        void handleWritable(int fd, FdState& state, std::vector<Completion>& completions);
+        void handleError(int fd, FdState& state, std::vector<Completion>& completions);
+        void waitForEvents(std::vector<std::pair<int, unsigned int>>& ready, int timeoutMs);
+
+        // block assignment
+        EventLoop& operator=(EventLoop& right) { return right; }
+
+        std::unordered_map<int, FdState> _fds;
+        int _pollFd;
+        bool _initialized;
+    };
+}
@@ -0,0 +1,184 @@
+#include "stdafx.h"
+
+namespace throf
+{
+    const int32_t HashMap::EMPTY_SLOT;
+    const int32_t HashMap::DELETED_SLOT;
+    const size_t HashMap::MIN_CAPACITY;
+
+    // the splitmix64 finalizer, to spread out small and sequential numbers
+    static uint64_t mix(uint64_t value)
+    {
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+    HashMap::HashMap(const ResourceAllocator<char>& allocator) :
+        _entries(allocator),
+        _index(MIN_CAPACITY, EMPTY_SLOT, allocator),
+        _live(0),
+        _used(0)
+    {
+    }
+
+    // static
+    bool HashMap::isKey(const StackElement& key)
+    {
+        return key.type() == StackElement::Number || key.type() == StackElement::Boolean || key.type() == StackElement::String;
+    }
+
+    // static
+    uint64_t HashMap::hash(const StackElement& key)
+    {
+        switch (key.type())
+        {
+        case StackElement::Number:
+            return mix(static_cast<uint64_t>(key.numberData()));
+        case StackElement::Boolean:
+            return mix(key.booleanData() ? 1 : 2) ^ StackElement::Boolean;
+        default:
+            {
+                // the bytes rather than the atom, so runtime strings hash the same
+                StringView text = key.stringData();
+                uint64_t ret = 14695981039346656037ULL;
+                for (size_t ii = 0; ii < text.size; ii++)
+                {
+                    ret = (ret ^ static_cast<unsigned char>(text.data[ii])) * 1099511628211ULL;
+                }
+                return mix(ret);
+            }
+        }
+    }
+
+    // static
+    bool HashMap::equal(const StackElement& left, const StackElement& right)
+    {
+        if (left.type() != right.type())
+        {
+            return false;
+        }
+
+        switch (left.type())
+        {
+        case StackElement::Number:
+            return left.numberData() == right.numberData();
+        case StackElement::Boolean:
+            return left.booleanData() == right.booleanData();
+        default:
+            if (left.interned() && right.interned())
+            {
+                return left.atom() == right.atom();
+            }
+            return 0 == left.stringData().compare(right.stringData());
+        }
+    }
+
+    size_t HashMap::probe(const StackElement& key, uint64_t hash) const
+    {
+        size_t mask = _index.size() - 1;
+        for (size_t slot = static_cast<size_t>(hash) & mask; ; slot = (slot + 1) & mask)
+        {
+            int32_t entry = _index[slot];
+            if (EMPTY_SLOT == entry)
+            {
+                return slot;
+            }
+            if (entry >= 0 && _entries[entry].hash == hash && equal(_entries[entry].key, key))
+            {
+                return slot;
+            }
+        }
+    }
+
+    const StackElement* HashMap::find(const StackElement& key) const
+    {
+        int32_t entry = _index[probe(key, hash(key))];
+        return (EMPTY_SLOT == entry) ? nullptr : &_entries[entry].value;
+    }
+
+    void HashMap::set(const StackElement& key, const StackElement& value)
+    {
+        // copies are made from the default resource; see PRIM_SET
+        DefaultResourceScope scope(_entries.get_allocator().resource());
+        StackElement storedValue(value);
+        storedValue.unshare();
+
+        uint64_t keyHash = hash(key);
+        size_t slot = probe(key, keyHash);
+        if (EMPTY_SLOT != _index[slot])
+        {
+            _entries[_index[slot]].value = std::move(storedValue);
+            return;
+        }
+
+        // keep the load, tombstones included, under three quarters
+        if ((_used + 1) * 4 > _index.size() * 3)
+        {
+            size_t capacity = MIN_CAPACITY;
+            while ((_live + 1) * 2 > capacity)
+            {
+                capacity *= 2;
+            }
+            rebuild(capacity);
+            slot = probe(key, keyHash);
+        }
+
+        Entry entry;
+        entry.hash = keyHash;
+        entry.key = key;
+        entry.key.unshare();
+        entry.value = std::move(storedValue);
+        entry.live = true;
+        _entries.push_back(std::move(entry));
+
+        _index[slot] = static_cast<int32_t>(_entries.size() - 1);
+        _live++;
+        _used++;
+    }
+
+    bool HashMap::erase(const StackElement& key)
+    {
+        size_t slot = probe(key, hash(key));
+        int32_t entry = _index[slot];
+        if (EMPTY_SLOT == entry)
+        {
+            return false;
+        }
+
+        _index[slot] = DELETED_SLOT;
+        _entries[entry].live = false;
+        _entries[entry].key = StackElement();
+        _entries[entry].value = StackElement();
+        _live--;
+        return true;
+    }
+
+    void HashMap::rebuild(size_t capacity)
+    {
+        Entries live(_entries.get_allocator());
+        live.reserve(_live);
+        for (auto itr = _entries.begin(); itr != _entries.end(); itr++)
+        {
+            if ((*itr).live)
+            {
+                live.push_back(std::move(*itr));
+            }
+        }
+        _entries.swap(live);
+
+        Index index(capacity, EMPTY_SLOT, _index.get_allocator());
+        size_t mask = capacity - 1;
+        for (size_t ii = 0; ii < _entries.size(); ii++)
+        {
+            size_t slot = static_cast<size_t>(_entries[ii].hash) & mask;
+            while (EMPTY_SLOT != index[slot])
+            {
+                slot = (slot + 1) & mask;
+            }
+            index[slot] = static_cast<int32_t>(ii);
+        }
+        _index.swap(index);
+        _used = _entries.size();
+    }
+}
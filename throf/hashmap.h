@@ -0,0 +1,76 @@
+#pragma once
+
+namespace throf
+{
+    // The map behind <hashmap>, at, set-at, delete-at, keys and each-entry, keyed by
+    // Numbers, Booleans and Strings. A Map element holds a pointer to one, so dup and
+    // variables share the map rather than copying it, and set-at is seen through every
+    // copy.
+    //
+    // Entries are kept densely in insertion order, which is also the order keys and
+    // each-entry visit them in. Lookups go through a separate open addressing index of
+    // entry numbers, probed linearly, so a probe sequence walks a run of 32-bit slots
+    // and only touches an entry when its hash matches. Deleted entries leave a
+    // tombstone in the index and a dead entry behind; both are cleared out the next
+    // time the index is rebuilt.
+    //
+    // A map and everything in it lives in the memory it was made with, the interpreter's
+    // long lived memory, since a map can outlive the request that made it.
+    class HashMap
+    {
+    public:
+        struct Entry
+        {
+            uint64_t hash;
+            StackElement key;
+            StackElement value;
+            bool live;
+        };
+
+        typedef std::vector<Entry, ResourceAllocator<Entry>> Entries;
+
+        explicit HashMap(const ResourceAllocator<char>& allocator);
+
+        // Numbers, Booleans and Strings; a runtime string finds the entry of an equal
+        // interned one
+        static bool isKey(const StackElement& key);
+
+        size_t size() const { return _live; }
+
+        // null if key is not in the map
+        const StackElement* find(const StackElement& key) const;
+
+        // Adds or replaces the entry for key. The key and value are copied into the
+        // map's memory.
+        void set(const StackElement& key, const StackElement& value);
+
+        // false if key was not in the map
+        bool erase(const StackElement& key);
+
+        // in insertion order, dead entries included
+        const Entries& entries() const { return _entries; }
+
+    private:
+        typedef std::vector<int32_t, ResourceAllocator<int32_t>> Index;
+
+        static const int32_t EMPTY_SLOT = -1;
+        static const int32_t DELETED_SLOT = -2;
+        static const size_t MIN_CAPACITY = 8;
+
+        static uint64_t hash(const StackElement& key);
+        static bool equal(const StackElement& left, const StackElement& right);
+
+        // the index slot holding key, or the empty slot ending its probe sequence
+        size_t probe(const StackElement& key, uint64_t hash) const;
+
+        // drops dead entries and reindexes the rest into capacity slots
+        void rebuild(size_t capacity);
+
+        Entries _entries;
+        Index _index;
+        size_t _live;
+
+        // index slots that are not empty, tombstones included
+        size_t _used;
+    };
+}
@@ -1,12 +1,33 @@
 #include "stdafx.h"
 #include "repl.h"
 #include <iostream>
+#include <iomanip>
 
 int* TOP_OF_STACK;
+const char* const PROFILE_FOLDED_FILENAME = "throf-profile.folded";
+const char* const SAMPLE_FOLDED_FILENAME = "throf-sample.folded";
 
 namespace throf
 {
-    Interpreter::Interpreter() : _filename("")
+    // superseded definitions allowed to pile up before a collection runs on its own
+    static const size_t GC_REDEFINITION_THRESHOLD = 256;
+
+    // string values live in request memory; the dictionaries are keyed by std::string
+    static inline string toString(const StringView& str)
+    {
+        return str.str();
+    }
+
+    Interpreter::Interpreter() :
+        _codeArena(new ArenaResource()),
+        _compilingDefinition(0),
+        _localsDefinitions(0),
+        _gcRequested(false),
+        _gcReport(false),
+        _redefinitionsSinceGc(0),
+        _memoryResource(heapResource()),
+        _scratchResource(heapResource()),
+        _filename("")
     {
         initialize();
     }
@@ -27,7 +48,7 @@ namespace throf
             string str = (*itr).first;
             PRIMITIVE_WORD prim = (*itr).second;
             _stringToWordDict[str] = prim;
-            _dictionary[prim] = vector<vector<StackElement>>();
+            _dictionary[prim] = vector<CodeVector>();
         }
 
         _stack.reserve(200);
@@ -51,6 +72,19 @@ namespace throf
             case StackElement::Variable:
                 errBuilder << "\"" << element.stringData() << "\" (string literal)";
                 break;
+            case StackElement::Double:
+            case StackElement::BigNumber:
+                errBuilder << "'" << numeric::format(element) << "' (number)";
+                break;
+            case StackElement::Array:
+                errBuilder << "array of " << element.arrayData()->size();
+                break;
+            case StackElement::Map:
+                errBuilder << "hashmap of " << element.mapData()->size();
+                break;
+            case StackElement::Tuple:
+                errBuilder << "tuple '" << _tupleClasses[element.tupleData()->classId].name << "'";
+                break;
             case StackElement::Nil:
             default:
                 errBuilder << "uninitialized (?)";
@@ -63,7 +97,7 @@ namespace throf
 
     void Interpreter::throwIfVariableNotDefined(const StackElement& element, const string msg) const
     {
-        if (!contains(_stringToWordDict, element.stringData()))
+        if (!contains(_dictionary, element.variableId()))
         {
             stringstream strBuilder;
             strBuilder << msg << " : type " << element.type() << ", data '" << element.stringData() << "'";
@@ -71,6 +105,49 @@ namespace throf
         }
     }
 
+    inline void Interpreter::push(const StackElement& elem)
+    {
+        if (_stack.size() >= _quota.maxStackDepth())
+        {
+            _quota.throwStackDepthExceeded();
+        }
+
+        _stack.push_back(elem);
+        _stats.pushes++;
+        if (_stack.size() > _stats.peakStackDepth)
+        {
+            _stats.peakStackDepth = _stack.size();
+        }
+    }
+
+    inline void Interpreter::push(StackElement&& elem)
+    {
+        if (_stack.size() >= _quota.maxStackDepth())
+        {
+            _quota.throwStackDepthExceeded();
+        }
+
+        _stack.push_back(std::move(elem));
+        _stats.pushes++;
+        if (_stack.size() > _stats.peakStackDepth)
+        {
+            _stats.peakStackDepth = _stack.size();
+        }
+    }
+
+    inline StackElement Interpreter::pop()
+    {
+        if (_stack.empty())
+        {
+            throw ThrofException("Interpreter", "stack underflow", _filename);
+        }
+
+        StackElement elem = std::move(_stack.back());
+        _stack.pop_back();
+        _stats.pops++;
+        return elem;
+    }
+
     inline int getCurrentStackSize()
     {
         int local;
@@ -81,19 +158,17 @@ namespace throf
         return curStackSize;
     }
 
-    void Interpreter::dispatch(const StackElement elem)
+    void Interpreter::dispatch(const StackElement& elem)
     {
         static const int MAX_ALLOWED_STACK = 1048576; // 1MB
 
         if (getCurrentStackSize() >= MAX_ALLOWED_STACK)
         {
-            stringstream errBuilder;
-            errBuilder << "Stack overflow detected. Infinite recursion may exist in your program. Current word: ";
-            errBuilder << elem.wordName();
-            throw ThrofException("Interpreter", errBuilder.str(), _filename);
+            throwStackOverflow(elem);
         }
 
-        string& filename = _filename;
+        _quota.tick();
+
         switch (elem.type())
         {
         case StackElement::Boolean:
@@ -101,7 +176,12 @@ namespace throf
         case StackElement::String:
         case StackElement::Quotation:
         case StackElement::Variable:
-            _stack.push_back(elem);
+        case StackElement::Array:
+        case StackElement::Double:
+        case StackElement::BigNumber:
+        case StackElement::Map:
+        case StackElement::Tuple:
+            push(elem);
             return;
         case StackElement::WordReference:
             break;
@@ -110,49 +190,21 @@ namespace throf
         }
 
         WORD_ID id = elem.wordRefId();
-
-        auto dispatch_arithmetic = [filename](WORD_ID operation, const StackElement& top, const StackElement& bottom)
-        {
-            switch (operation)
-            {
-            case PRIM_ADD:
-                return bottom.numberData() + top.numberData();
-            case PRIM_SUB:
-                return bottom.numberData() - top.numberData();
-            case PRIM_MUL:
-                return bottom.numberData() * top.numberData();
-            case PRIM_DIV:
-                return bottom.numberData() / top.numberData();
-            case PRIM_MOD:
-                return bottom.numberData() % top.numberData();
-            }
-
-            stringstream strBuilder;
-            strBuilder << "unexpected word passed as arithmetic word : '" << operation << "'";
-            throw ThrofException("Interpreter", strBuilder.str(), filename);
-        };
-
-        auto dispatch_comparison = [filename](WORD_ID operation, const StackElement& top, const StackElement& bottom)
-        {
-            switch(operation)
-            {
-            case PRIM_LT:
-                return bottom.numberData() < top.numberData();
-            case PRIM_GT:
-                return bottom.numberData() > top.numberData();
-            case PRIM_LTE:
-                return bottom.numberData() <= top.numberData();
-            case PRIM_GTE:
-                return bottom.numberData() >= top.numberData();
-            }
-
-            stringstream strBuilder;
-            strBuilder << "unexpected word passed as comparison word : '" << operation << "'";
-            throw ThrofException("Interpreter", strBuilder.str(), filename);
-        };
+        Profiler::Scope profileScope(_profiler, id);
+        Sampler::Scope sampleScope(_sampler, id);
+        Tracer::Scope traceScope(_tracer, id, _stack);
+        RuntimeStats::CallScope callScope(_stats);
 
         switch(id)
         {
+        case PRIM_STATS:
+            cout << statsToString();
+            break;
+        case PRIM_GC:
+            // definitions may be executing right now; collect once back at the top level
+            _gcRequested = true;
+            _gcReport = true;
+            break;
         case PRIM_WORDS:
             cout << loadedWordsToString();
             break;
@@ -162,63 +214,379 @@ namespace throf
         case PRIM_STACK:
             cout << stackToString();
             break;
+        case PRIM_IF:
+        case PRIM_TIMES:
+        case PRIM_WHILE:
+        case PRIM_UNTIL:
+        case PRIM_EACH:
+        case PRIM_LOOP:
+            dispatchControlWord(id);
+            break;
+        case PRIM_CALL:
+        case PRIM_DIP:
+        case PRIM_KEEP:
+        case PRIM_BI:
+        case PRIM_TRI:
+        case PRIM_BI_AT:
+        case PRIM_CURRY:
+        case PRIM_COMPOSE:
+            dispatchCombinatorWord(id);
+            break;
+        case PRIM_DROP:
+        case PRIM_SWAP:
+        case PRIM_TWOSWAP:
+        case PRIM_ROT:
+        case PRIM_NROT:
+        case PRIM_PICK:
+            dispatchStackWord(id);
+            break;
+        case PRIM_SET:
+        case PRIM_GET:
+            dispatchVariableWord(id);
+            break;
+        case PRIM_ADD:
+        case PRIM_SUB:
+        case PRIM_MUL:
+        case PRIM_DIV:
+        case PRIM_MOD:
+        case PRIM_LT:
+        case PRIM_GT:
+        case PRIM_LTE:
+        case PRIM_GTE:
+            dispatchNumericWord(id);
+            break;
+        case PRIM_EQ:
+        case PRIM_NEQ:
+        case PRIM_NOT:
+        case PRIM_AND:
+        case PRIM_OR:
+        case PRIM_XOR:
+            dispatchLogicWord(id);
+            break;
+        case PRIM_PRINT:
+        case PRIM_PROFILE_ON:
+        case PRIM_PROFILE_OFF:
+        case PRIM_PROFILE_REPORT:
+        case PRIM_SAMPLE_ON:
+        case PRIM_SAMPLE_OFF:
+        case PRIM_SAMPLE_REPORT:
+        case PRIM_TRACE_ON:
+        case PRIM_TRACE_OFF:
+        case PRIM_BENCH:
+            dispatchReportingWord(id);
+            break;
+        case PRIM_SOCKETPAIR:
+        case PRIM_PIPE:
+        case PRIM_TCP_LISTEN:
+        case PRIM_TCP_CONNECT:
+        case PRIM_UNIX_LISTEN:
+        case PRIM_UNIX_CONNECT:
+        case PRIM_LOCAL_PORT:
+        case PRIM_ON_ACCEPT:
+        case PRIM_ON_READ:
+        case PRIM_ON_READ_LINE:
+        case PRIM_WRITE_ASYNC:
+        case PRIM_CLOSE:
+        case PRIM_RUN_LOOP:
+            dispatchEventLoopWord(id);
+            break;
+        case PRIM_TO_ARRAY:
+        case PRIM_TO_DOUBLES:
+        case PRIM_IOTA:
+        case PRIM_VLENGTH:
+        case PRIM_VNTH:
+        case PRIM_VADD:
+        case PRIM_VMUL:
+        case PRIM_VSUM:
+        case PRIM_VDOT:
+        case PRIM_VMIN:
+        case PRIM_VMAX:
+        case PRIM_VMAP_AFFINE:
+        case PRIM_SORT:
+        case PRIM_SORT_BY:
+        case PRIM_BINARY_SEARCH:
+        case PRIM_PARTITION:
+        case PRIM_UNIQUE:
+            dispatchArrayWord(id);
+            break;
+        case PRIM_LENGTH:
+        case PRIM_CONCAT:
+        case PRIM_SUBSEQ:
+        case PRIM_HEAD:
+        case PRIM_TAIL:
+        case PRIM_FIND:
+        case PRIM_SPLIT:
+        case PRIM_JOIN:
+            dispatchStringWord(id);
+            break;
+        case PRIM_NEW_HASHMAP:
+        case PRIM_AT:
+        case PRIM_SET_AT:
+        case PRIM_DELETE_AT:
+        case PRIM_KEYS:
+        case PRIM_EACH_ENTRY:
+            dispatchMapWord(id);
+            break;
+        case PRIM_NEW_TUPLE:
+        case PRIM_IS_TUPLE:
+        case PRIM_SLOT_GET:
+        case PRIM_SLOT_SET:
+            dispatchTupleWord(elem);
+            break;
+        case PRIM_BIND_LOCALS:
+            // bound where the definition starts running, see below
+            throw ThrofException("Interpreter", "'bind-locals' only starts a word defined with ::", _filename);
+        case PRIM_LOCAL:
+            pushLocal(elem);
+            break;
+        case PRIM_CAPTURE_LOCALS:
+            captureLocals(elem);
+            break;
+        default:
+            // Non-core word used
+            // definitions are only added or replaced at the top level, never while one
+            // is executing, so the code can be run in place
+            const CodeVector& def = _dictionary[elem.wordRefId()][elem.wordRefCurrentOffset()];
+            if (!def.empty() && def.front().type() == StackElement::WordReference && def.front().wordRefId() == PRIM_BIND_LOCALS)
+            {
+                callWithLocals(def);
+                break;
+            }
+
+            for (auto itr = def.cbegin(); itr != def.cend(); itr++)
+            {
+                const StackElement& innerElem = *itr;
+                switch(innerElem.type())
+                {
+                case StackElement::Boolean:
+                case StackElement::Number:
+                case StackElement::String:
+                case StackElement::Variable:
+                case StackElement::Quotation:
+                case StackElement::Array:
+                case StackElement::Double:
+                case StackElement::BigNumber:
+                case StackElement::Map:
+                case StackElement::Tuple:
+                    push(innerElem);
+                    break;
+                case StackElement::WordReference:
+                    dispatch(innerElem);
+                    break;
+                case StackElement::Nil:
+                default:
+                    break;
+                }
+            }
+            break;
+        }
+    }
+
+    // kept out of dispatch so its stream does not add to every dispatch frame
+    void Interpreter::throwStackOverflow(const StackElement& elem)
+    {
+        stringstream errBuilder;
+        errBuilder << "Stack overflow detected. Infinite recursion may exist in your program. Current word: ";
+        prettyFormatStackElement(elem, errBuilder);
+        throw ThrofException("Interpreter", errBuilder.str(), _filename);
+    }
+
+    // The quota and the memory limit don't know which file is running, so QuotaExceeded
+    // gets the filename here, from the innermost file that had it in flight.
+    void Interpreter::rethrowWithFilename(const QuotaExceeded& e)
+    {
+        if (*e.filename() != '\0')
+        {
+            throw e;
+        }
+        throw QuotaExceeded(e.quota(), e.what(), _filename);
+    }
+
+    // The word groups below are dispatched out of line: dispatch is on the native stack
+    // once per nested call, so locals in its cases would cost stack depth on every level.
+    // The loops tick the quota once per iteration, as an empty body dispatches nothing.
+    void Interpreter::dispatchControlWord(WORD_ID id)
+    {
+        switch (id)
+        {
         case PRIM_IF:
             {
-                StackElement falseQuotation = _stack.back(); _stack.pop_back();
-                StackElement trueQuotation = _stack.back(); _stack.pop_back();
-                StackElement boolOutcome = _stack.back(); _stack.pop_back();
+                StackElement falseQuotation = pop();
+                StackElement trueQuotation = pop();
+                StackElement boolOutcome = pop();
 
                 throwIfTypeUnexpected(falseQuotation, StackElement::Quotation, "Expected quotation as 3rd stack argument to 'if' word : ");
                 throwIfTypeUnexpected(trueQuotation, StackElement::Quotation, "Expected quotation as 2nd stack argument to 'if' word : ");
 
-                const vector<StackElement>& q = boolOutcome.booleanData() ? trueQuotation.quotationData() : falseQuotation.quotationData();
-                for (auto elem : q)
+                callQuotation(boolOutcome.booleanData() ? trueQuotation : falseQuotation);
+            }
+            break;
+        case PRIM_TIMES:
+            {
+                StackElement body = pop();
+                StackElement count = pop();
+                throwIfTypeUnexpected(body, StackElement::Quotation, "expected quotation as body of 'times', got : ");
+                throwIfTypeUnexpected(count, StackElement::Number, "expected iteration count for 'times', got : ");
+
+                for (long ii = count.numberData(); ii > 0; ii--)
                 {
-                    dispatch(elem);
+                    _quota.tick();
+                    callQuotation(body);
                 }
             }
             break;
-        case PRIM_DROP:
-            _stack.pop_back();
-            break;
-        case PRIM_SWAP:
+        case PRIM_WHILE:
+        case PRIM_UNTIL:
             {
-                StackElement topOrig = _stack.back(); _stack.pop_back();
-                StackElement bottomOrig = _stack.back(); _stack.pop_back();
-                _stack.push_back(topOrig);
-                _stack.push_back(bottomOrig);
+                StackElement body = pop();
+                StackElement predicate = pop();
+                throwIfTypeUnexpected(body, StackElement::Quotation, "expected quotation as loop body, got : ");
+                throwIfTypeUnexpected(predicate, StackElement::Quotation, "expected quotation as loop predicate, got : ");
+
+                // while runs the body as long as the predicate leaves true, until as
+                // long as it leaves false
+                bool exitOn = (id == PRIM_UNTIL);
+                for (;;)
+                {
+                    _quota.tick();
+                    callQuotation(predicate);
+                    if (pop().booleanData() == exitOn)
+                    {
+                        break;
+                    }
+                    callQuotation(body);
+                }
             }
             break;
-        case PRIM_TWOSWAP:
+        case PRIM_EACH:
             {
-                StackElement idx4 = _stack.back(); _stack.pop_back();
-                StackElement idx3 = _stack.back(); _stack.pop_back();
-                auto itr = _stack.end();
-                itr -= 2;
-                _stack.emplace(itr, idx4);
-                _stack.emplace(itr, idx3);
+                StackElement body = pop();
+                StackElement items = pop();
+                throwIfTypeUnexpected(body, StackElement::Quotation, "expected quotation as body of 'each', got : ");
+                throwIfTypeUnexpected(items, StackElement::Quotation, "expected quotation of items for 'each', got : ");
+
+                // the items are pushed as they are, not executed
+                CodeVector flattened;
+                const CodeVector& elements = (nullptr != items.closure()) ? (flattened = items.flattenQuotation()) : items.quotationData();
+                for (auto itr = elements.cbegin(); itr != elements.cend(); itr++)
+                {
+                    _quota.tick();
+                    push(*itr);
+                    callQuotation(body);
+                }
             }
             break;
-        case PRIM_SET:
+        case PRIM_LOOP:
             {
-                StackElement variableName = _stack.back(); _stack.pop_back();
-                StackElement value = _stack.back(); _stack.pop_back();
+                // runs the body again for as long as it leaves true on the stack
+                StackElement body = pop();
+                throwIfTypeUnexpected(body, StackElement::Quotation, "expected quotation as body of 'loop', got : ");
 
-                throwIfTypeUnexpected(variableName, StackElement::Variable, "unexpected variable name ");
-                throwIfVariableNotDefined(variableName, "variable not defined ");
-                _dictionary[_stringToWordDict[variableName.stringData()]].back()[0] = value;
+                do
+                {
+                    _quota.tick();
+                    callQuotation(body);
+                } while (pop().booleanData());
             }
             break;
-        case PRIM_GET:
+        }
+    }
+
+    void Interpreter::dispatchCombinatorWord(WORD_ID id)
+    {
+        switch (id)
+        {
+        case PRIM_CALL:
+            callQuotation(popQuotation("call"));
+            break;
+        case PRIM_DIP:
             {
-                StackElement variableName = _stack.back(); _stack.pop_back();
-                throwIfTypeUnexpected(variableName, StackElement::Variable, "unexpected variable name ");
+                StackElement quotation = popQuotation("dip");
+                StackElement saved = pop();
+                callQuotation(quotation);
+                push(std::move(saved));
+            }
+            break;
+        case PRIM_KEEP:
+            {
+                StackElement quotation = popQuotation("keep");
+                StackElement saved = pop();
+                push(saved);
+                callQuotation(quotation);
+                push(std::move(saved));
+            }
+            break;
+        case PRIM_BI:
+        case PRIM_TRI:
+            {
+                // x p q bi runs p and q on x each; tri adds a third quotation
+                StackElement last = popQuotation(id == PRIM_BI ? "bi" : "tri");
+                StackElement middle = popQuotation(id == PRIM_BI ? "bi" : "tri");
+                StackElement first = (id == PRIM_TRI) ? popQuotation("tri") : StackElement();
+                StackElement x = pop();
 
-                throwIfTypeUnexpected(variableName, StackElement::Variable, "unexpected variable name ");
-                throwIfVariableNotDefined(variableName, "variable not defined ");
+                if (id == PRIM_TRI)
+                {
+                    push(x);
+                    callQuotation(first);
+                }
+                push(x);
+                callQuotation(middle);
+                push(std::move(x));
+                callQuotation(last);
+            }
+            break;
+        case PRIM_BI_AT:
+            {
+                // x y q bi@ runs q on x and then on y
+                StackElement quotation = popQuotation("bi@");
+                StackElement y = pop();
+                push(pop());
+                callQuotation(quotation);
+                push(std::move(y));
+                callQuotation(quotation);
+            }
+            break;
+        case PRIM_CURRY:
+            {
+                StackElement quotation = popQuotation("curry");
+                StackElement value = pop();
+                push(StackElement::curry(std::move(value), std::move(quotation)));
+            }
+            break;
+        case PRIM_COMPOSE:
+            {
+                StackElement second = popQuotation("compose");
+                StackElement first = popQuotation("compose");
+                push(StackElement::compose(std::move(first), std::move(second)));
+            }
+            break;
+        }
+    }
 
-                StackElement data = _dictionary[_stringToWordDict[variableName.stringData()]].back().back();
-                _stack.push_back(data);
+    void Interpreter::dispatchStackWord(WORD_ID id)
+    {
+        switch (id)
+        {
+        case PRIM_DROP:
+            pop();
+            break;
+        case PRIM_SWAP:
+            {
+                StackElement topOrig = pop();
+                StackElement bottomOrig = pop();
+                push(topOrig);
+                push(bottomOrig);
+            }
+            break;
+        case PRIM_TWOSWAP:
+            {
+                StackElement idx4 = pop();
+                StackElement idx3 = pop();
+                auto itr = _stack.end();
+                itr -= 2;
+                _stack.emplace(itr, idx4);
+                _stack.emplace(itr, idx3);
             }
             break;
         case PRIM_ROT:
@@ -227,12 +595,12 @@ namespace throf
                 itr -= 3;
                 StackElement elem = *itr;
                 _stack.erase(itr);
-                _stack.push_back(elem);
+                push(elem);
             }
             break;
         case PRIM_NROT:
             {
-                StackElement elem = _stack.back(); _stack.pop_back();
+                StackElement elem = pop();
                 auto itr = _stack.end();
                 itr -= 2;
                 _stack.insert(itr, elem);
@@ -240,7 +608,7 @@ namespace throf
             break;
         case PRIM_PICK:
             {
-                StackElement elemIndex = _stack.back(); _stack.pop_back();
+                StackElement elemIndex = pop();
                 throwIfTypeUnexpected(elemIndex, StackElement::Number, "expected number, got : ");
 
                 if (elemIndex.numberData() < 0)
@@ -256,20 +624,88 @@ namespace throf
                     id++;
                 }
                 StackElement elem = *itr;
-                _stack.push_back(elem);
+                push(elem);
             }
             break;
+        }
+    }
+
+    void Interpreter::dispatchVariableWord(WORD_ID id)
+    {
+        switch (id)
+        {
+        case PRIM_SET:
+            {
+                StackElement variableName = pop();
+                StackElement value = pop();
+
+                throwIfTypeUnexpected(variableName, StackElement::Variable, "unexpected variable name ");
+                throwIfVariableNotDefined(variableName, "variable not defined ");
+
+                // variables outlive any one request, so their values are kept in long lived
+                // memory. Moving the copy in takes its allocator along; assigning would copy
+                // into whatever memory the slot happens to have, the code arena included.
+                // Values that own no memory are assigned.
+                StackElement& slot = _dictionary[variableName.variableId()].back()[0];
+                if (!value.ownsMemory())
+                {
+                    slot = value;
+                }
+                else
+                {
+                    DefaultResourceScope scope(_memoryResource);
+                    StackElement stored(value);
+                    stored.unshare();
+                    slot = std::move(stored);
+                }
+            }
+            break;
+        case PRIM_GET:
+            {
+                StackElement variableName = pop();
+                throwIfTypeUnexpected(variableName, StackElement::Variable, "unexpected variable name ");
+
+                throwIfTypeUnexpected(variableName, StackElement::Variable, "unexpected variable name ");
+                throwIfVariableNotDefined(variableName, "variable not defined ");
+
+                StackElement data = _dictionary[variableName.variableId()].back().back();
+                push(data);
+            }
+            break;
+        }
+    }
+
+    void Interpreter::dispatchNumericWord(WORD_ID id)
+    {
+        switch (id)
+        {
         case PRIM_ADD:
         case PRIM_SUB:
         case PRIM_MUL:
         case PRIM_DIV:
         case PRIM_MOD:
             {
-                StackElement top = _stack.back(); _stack.pop_back();
-                StackElement bottom = _stack.back(); _stack.pop_back();
-                throwIfTypeUnexpected(top, StackElement::Number, "expected number, got : ");
-                throwIfTypeUnexpected(bottom, StackElement::Number, "expected number, got : ");
-                _stack.push_back(StackElement(StackElement::Number, dispatch_arithmetic(id, top, bottom)));
+                // two int64s that neither overflow nor divide by zero stay on the fast
+                // path; the rest goes through the numeric tower
+                StackElement top = pop();
+                StackElement bottom = pop();
+                int64_t result;
+                if (top.type() == StackElement::Number && bottom.type() == StackElement::Number
+                    && numeric::int64Arithmetic(id, bottom.numberData(), top.numberData(), result))
+                {
+                    push(StackElement(StackElement::Number, result));
+                    break;
+                }
+
+                if (!numeric::isNumeric(top))
+                {
+                    throwIfTypeUnexpected(top, StackElement::Number, "expected number, got : ");
+                }
+                if (!numeric::isNumeric(bottom))
+                {
+                    throwIfTypeUnexpected(bottom, StackElement::Number, "expected number, got : ");
+                }
+                push(numeric::arithmetic(id, bottom, top, _filename));
             }
             break;
         case PRIM_LT:
@@ -277,21 +713,52 @@ namespace throf
         case PRIM_LTE:
         case PRIM_GTE:
             {
-                StackElement top = _stack.back(); _stack.pop_back();
-                StackElement bottom = _stack.back(); _stack.pop_back();
-                throwIfTypeUnexpected(top, StackElement::Number, "expected number, got : ");
-                throwIfTypeUnexpected(bottom, StackElement::Number, "expected number, got : ");
-                _stack.push_back(StackElement(StackElement::Boolean,
-                    StackElement::BooleanType(dispatch_comparison(id, top, bottom))));
+                StackElement top = pop();
+                StackElement bottom = pop();
+                if (!numeric::isNumeric(top))
+                {
+                    throwIfTypeUnexpected(top, StackElement::Number, "expected number, got : ");
+                }
+                if (!numeric::isNumeric(bottom))
+                {
+                    throwIfTypeUnexpected(bottom, StackElement::Number, "expected number, got : ");
+                }
+
+                bool ret = false;
+                switch (id)
+                {
+                case PRIM_LT:
+                    ret = numeric::less(bottom, top);
+                    break;
+                case PRIM_GT:
+                    ret = numeric::less(top, bottom);
+                    break;
+                case PRIM_LTE:
+                    ret = numeric::less(bottom, top) || numeric::equal(bottom, top);
+                    break;
+                case PRIM_GTE:
+                    ret = numeric::less(top, bottom) || numeric::equal(bottom, top);
+                    break;
+                }
+                push(StackElement(StackElement::Boolean, StackElement::BooleanType(ret)));
             }
             break;
+        }
+    }
+
+    void Interpreter::dispatchLogicWord(WORD_ID id)
+    {
+        switch (id)
+        {
         case PRIM_EQ:
         case PRIM_NEQ:
             {
-                StackElement top = _stack.back(); _stack.pop_back();
-                StackElement bottom = _stack.back(); _stack.pop_back();
+                StackElement top = pop();
+                StackElement bottom = pop();
 
-                if (top.type() != bottom.type())
+                // numbers compare by value whatever their representation
+                bool numbers = numeric::isNumeric(top) && numeric::isNumeric(bottom);
+                if (top.type() != bottom.type() && !numbers)
                 {
                     stringstream strBuilder;
                     strBuilder << "unexpected mismatch of types on stack when excuting " << PRIM_WORD_TO_STR_MAP.at(id);
@@ -300,13 +767,14 @@ namespace throf
                 }
 
                 bool ret = false;
-                switch (top.type())
+                switch (numbers ? StackElement::Number : top.type())
                 {
                 case StackElement::String:
-                    ret = 0 == top.stringData().compare(bottom.stringData());
+                    // a runtime string can still equal an interned one
+                    ret = (top.interned() && bottom.interned()) ? top.atom() == bottom.atom() : 0 == top.stringData().compare(bottom.stringData());
                     break;
                 case StackElement::Number:
-                    ret = top.numberData() == bottom.numberData();
+                    ret = numeric::equal(top, bottom);
                     break;
                 case StackElement::Boolean:
                     ret = top.booleanData() == bottom.booleanData();
@@ -324,14 +792,14 @@ namespace throf
                     ret = !ret;
                 }
 
-                _stack.push_back(StackElement(StackElement::Boolean, StackElement::BooleanType(ret)));
+                push(StackElement(StackElement::Boolean, StackElement::BooleanType(ret)));
             }
             break;
         case PRIM_NOT:
             {
-                StackElement elem = _stack.back(); _stack.pop_back();
+                StackElement elem = pop();
                 throwIfTypeUnexpected(elem, StackElement::Boolean, "expected boolean, got : ");
-                _stack.push_back(StackElement(StackElement::Boolean,
+                push(StackElement(StackElement::Boolean,
                     StackElement::BooleanType(!elem.booleanData())));
             }
             break;
@@ -339,8 +807,8 @@ namespace throf
         case PRIM_OR:
         case PRIM_XOR:
             {
-                StackElement top = _stack.back(); _stack.pop_back();
-                StackElement bottom = _stack.back(); _stack.pop_back();
+                StackElement top = pop();
+                StackElement bottom = pop();
                 throwIfTypeUnexpected(top, StackElement::Boolean, "expected boolean, got : ");
                 throwIfTypeUnexpected(bottom, StackElement::Boolean, "expected boolean, got : ");
 
@@ -358,159 +826,1778 @@ namespace throf
                     break;
                 }
 
-                _stack.push_back(StackElement(StackElement::Boolean,
+                push(StackElement(StackElement::Boolean,
                     StackElement::BooleanType(ret)));
             }
             break;
-            
-        default:
-            // Non-core word used
-            auto def = _dictionary[elem.wordRefId()][elem.wordRefCurrentOffset()];
-            for (auto itr = def.begin(); itr != def.end(); itr++)
+        }
+    }
+
+    void Interpreter::dispatchReportingWord(WORD_ID id)
+    {
+        switch (id)
+        {
+        case PRIM_PRINT:
             {
-                const StackElement& innerElem = *itr;
-                switch(innerElem.type())
+                StackElement elem = pop();
+                if (elem.type() == StackElement::String)
+                {
+                    cout << elem.stringData();
+                }
+                else
+                {
+                    stringstream strBuilder;
+                    prettyFormatStackElement(elem, strBuilder);
+                    string str = strBuilder.str();
+                    cout << str.substr(0, str.find_last_not_of(' ') + 1);
+                }
+                cout << '\n';
+            }
+            break;
+        case PRIM_PROFILE_ON:
+            _profiler.start();
+            break;
+        case PRIM_PROFILE_OFF:
+            _profiler.stop();
+            break;
+        case PRIM_PROFILE_REPORT:
+            reportProfile();
+            break;
+        case PRIM_SAMPLE_ON:
+            {
+                StackElement frequency = pop();
+                throwIfTypeUnexpected(frequency, StackElement::Number, "expected sampling frequency (Hz), got : ");
+                _sampler.start(frequency.numberData());
+            }
+            break;
+        case PRIM_SAMPLE_OFF:
+            _sampler.stop();
+            break;
+        case PRIM_SAMPLE_REPORT:
+            reportSamples();
+            break;
+        case PRIM_TRACE_ON:
+            {
+                StackElement filename = pop();
+                throwIfTypeUnexpected(filename, StackElement::String, "expected trace file name, got : ");
+                startTracing(toString(filename.stringData()));
+            }
+            break;
+        case PRIM_TRACE_OFF:
+            stopTracing();
+            break;
+        case PRIM_BENCH:
+            {
+                StackElement iterations = pop();
+                StackElement quotation = pop();
+                throwIfTypeUnexpected(iterations, StackElement::Number, "expected iteration count, got : ");
+                throwIfTypeUnexpected(quotation, StackElement::Quotation, "expected quotation to benchmark, got : ");
+                ThrofException::throwIfTrue(iterations.numberData() <= 0, "Interpreter", "iteration count must be positive");
+                benchmark(quotation, iterations.numberData());
+            }
+            break;
+        }
+    }
+
+    // the frame of the innermost running call to the :: word a local belongs to
+    const Interpreter::Frame& Interpreter::frameOf(const StackElement& local)
+    {
+        size_t definition = static_cast<size_t>(local.numberData());
+        auto frame = _frames.rbegin();
+        while (frame != _frames.rend() && (*frame).definition != definition)
+        {
+            frame++;
+        }
+
+        if (frame == _frames.rend())
+        {
+            stringstream strBuilder;
+            strBuilder << "local '" << local.wordName() << "' used outside of the word it belongs to";
+            throw ThrofException("Interpreter", strBuilder.str(), _filename);
+        }
+        return *frame;
+    }
+
+    void Interpreter::pushLocal(const StackElement& local)
+    {
+        push(_locals[frameOf(local).base + local.wordRefCurrentOffset()]);
+    }
+
+    // true if code reads a local of the given :: definition, in nested quotations too
+    static bool usesLocals(const CodeVector& code, size_t definition)
+    {
+        for (auto itr = code.cbegin(); itr != code.cend(); itr++)
+        {
+            if ((*itr).type() == StackElement::WordReference && (*itr).wordRefId() == PRIM_LOCAL &&
+                static_cast<size_t>((*itr).numberData()) == definition)
+            {
+                return true;
+            }
+            if ((*itr).type() == StackElement::Quotation && usesLocals((*itr).quotationData(), definition))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Copies code with every local of the frame's definition replaced by its value.
+    CodeVector Interpreter::captureLocals(const CodeVector& code, const Frame& frame)
+    {
+        CodeVector captured;
+        captured.reserve(code.size());
+        for (auto itr = code.cbegin(); itr != code.cend(); itr++)
+        {
+            const StackElement& elem = *itr;
+            if (elem.type() == StackElement::WordReference && elem.wordRefId() == PRIM_LOCAL &&
+                static_cast<size_t>(elem.numberData()) == frame.definition)
+            {
+                captured.push_back(_locals[frame.base + elem.wordRefCurrentOffset()]);
+            }
+            else if (elem.type() == StackElement::Quotation && usesLocals(elem.quotationData(), frame.definition))
+            {
+                captured.push_back(StackElement(StackElement::Quotation, captureLocals(elem.quotationData(), frame)));
+            }
+            else
+            {
+                captured.push_back(elem);
+            }
+        }
+        return captured;
+    }
+
+    // A quotation that reads locals is followed by capture-locals in the body of its
+    // :: word. The values are put in when the quotation is pushed, so it sees the
+    // frame it was made in even if it is called from a deeper, recursive call of the
+    // same word or after its word has returned.
+    void Interpreter::captureLocals(const StackElement& capture)
+    {
+        StackElement quotation = popQuotation(PRIM_CAPTURE_LOCALS_STR);
+        push(StackElement(StackElement::Quotation, captureLocals(quotation.quotationData(), frameOf(capture))));
+    }
+
+    // moves the inputs off the stack, the first of them deepest, into a new frame
+    Interpreter::FrameScope::FrameScope(Interpreter& interpreter, const StackElement& bindLocals) :
+        _interpreter(interpreter)
+    {
+        CodeVector& stack = _interpreter._stack;
+        size_t count = static_cast<size_t>(bindLocals.wordRefCurrentOffset());
+        if (stack.size() < count)
+        {
+            throw ThrofException("Interpreter", "stack underflow", _interpreter._filename);
+        }
+
+        Frame frame = { static_cast<size_t>(bindLocals.numberData()), _interpreter._locals.size() };
+        _interpreter._locals.insert(_interpreter._locals.end(), make_move_iterator(stack.end() - count), make_move_iterator(stack.end()));
+        _interpreter._frames.push_back(frame);
+
+        stack.resize(stack.size() - count);
+        _interpreter._stats.pops += count;
+    }
+
+    Interpreter::FrameScope::~FrameScope()
+    {
+        _interpreter._locals.resize(_interpreter._frames.back().base);
+        _interpreter._frames.pop_back();
+    }
+
+    // runs a definition that starts with bind-locals, the rest of it like any other
+    void Interpreter::callWithLocals(const CodeVector& def)
+    {
+        FrameScope frame(*this, def.front());
+        for (auto itr = def.cbegin() + 1; itr != def.cend(); itr++)
+        {
+            if ((*itr).type() == StackElement::WordReference)
+            {
+                dispatch(*itr);
+            }
+            else if ((*itr).type() != StackElement::Nil)
+            {
+                push(*itr);
+            }
+        }
+    }
+
+    // the closure parts are run in place, nothing is spliced together
+    void Interpreter::callQuotation(const StackElement& quotation)
+    {
+        const StackElement::Closure* closure = quotation.closure();
+        if (nullptr != closure)
+        {
+            if (closure->kind == StackElement::Closure::Curry)
+            {
+                push(closure->first);
+            }
+            else
+            {
+                callQuotation(closure->first);
+            }
+            callQuotation(closure->second);
+            return;
+        }
+
+        const CodeVector& q = quotation.quotationData();
+        for (auto itr = q.cbegin(); itr != q.cend(); itr++)
+        {
+            dispatch(*itr);
+        }
+    }
+
+    StackElement Interpreter::popQuotation(const char* word)
+    {
+        StackElement elem = pop();
+        if (elem.type() != StackElement::Quotation)
+        {
+            stringstream strBuilder;
+            strBuilder << "expected quotation for '" << word << "', got : ";
+            throwIfTypeUnexpected(elem, StackElement::Quotation, strBuilder.str());
+        }
+        return elem;
+    }
+
+    // Runs the quotation `iterations` times after a warmup, putting the data stack back
+    // the way it was after every run, prints the timing summary and pushes the median
+    // in nanoseconds.
+    void Interpreter::benchmark(const StackElement& quotation, long iterations)
+    {
+        const CodeVector savedStack = _stack;
+
+        long warmup = Benchmark::warmupIterations(iterations);
+        for (long ii = 0; ii < warmup; ii++)
+        {
+            callQuotation(quotation);
+            _stack = savedStack;
+        }
+
+        // the count comes from the script, so only so much is reserved up front
+        static const long MAX_RESERVED_SAMPLES = 1 << 20;
+        vector<unsigned long long> samplesNs, cycleSamples;
+        samplesNs.reserve(std::min(iterations, MAX_RESERVED_SAMPLES));
+        cycleSamples.reserve(std::min(iterations, MAX_RESERVED_SAMPLES));
+        unsigned long long overheadNs = Benchmark::clockOverheadNs();
+        unsigned long long stringAllocations = 0, quotationAllocations = 0;
+
+        for (long ii = 0; ii < iterations; ii++)
+        {
+            StackElement::AllocationStats before = StackElement::allocationStats();
+            unsigned long long startCycles = Benchmark::cycles();
+            Benchmark::Clock::time_point start = Benchmark::Clock::now();
+
+            callQuotation(quotation);
+
+            Benchmark::Clock::time_point end = Benchmark::Clock::now();
+            unsigned long long endCycles = Benchmark::cycles();
+            const StackElement::AllocationStats& after = StackElement::allocationStats();
+
+            unsigned long long ns = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+            samplesNs.push_back(ns > overheadNs ? ns - overheadNs : 0);
+            if (endCycles != startCycles)
+            {
+                cycleSamples.push_back(endCycles - startCycles);
+            }
+            stringAllocations += after.stringAllocations - before.stringAllocations;
+            quotationAllocations += after.quotationAllocations - before.quotationAllocations;
+
+            _stack = savedStack;
+        }
+
+        Benchmark::Summary summary = Benchmark::summarize(samplesNs, cycleSamples);
+
+        // formatted on its own stream so cout keeps its flags and precision
+        stringstream report;
+        report << "bench: " << iterations << " iterations after " << warmup << " warmup" << endl;
+        report << "\tmin " << summary.minNs << " ns, median " << summary.medianNs << " ns, p99 " << summary.p99Ns;
+        report << " ns, max " << summary.maxNs << " ns, mean " << fixed << setprecision(1) << summary.meanNs << " ns" << endl;
+        if (summary.medianCycles > 0)
+        {
+            report << "\tmedian " << summary.medianCycles << " cycles" << endl;
+        }
+        report << "\tper iteration: " << setprecision(2) << static_cast<double>(stringAllocations) / iterations;
+        report << " string allocations, " << static_cast<double>(quotationAllocations) / iterations;
+        report << " quotation allocations" << endl;
+        cout << report.str() << flush;
+
+        push(StackElement(StackElement::Number, static_cast<long>(summary.medianNs)));
+    }
+
+    void Interpreter::dispatchEventLoopWord(WORD_ID id)
+    {
+        auto popNumber = [this]()
+        {
+            StackElement elem = pop();
+            throwIfTypeUnexpected(elem, StackElement::Number, "expected number, got : ");
+            return static_cast<int>(elem.numberData());
+        };
+
+        auto popQuotation = [this]()
+        {
+            StackElement elem = pop();
+            throwIfTypeUnexpected(elem, StackElement::Quotation, "expected quotation, got : ");
+            return elem;
+        };
+
+        auto popString = [this]()
+        {
+            StackElement elem = pop();
+            throwIfTypeUnexpected(elem, StackElement::String, "expected string, got : ");
+            return toString(elem.stringData());
+        };
+
+        switch (id)
+        {
+        case PRIM_SOCKETPAIR:
+        case PRIM_PIPE:
+            {
+                int first = -1, second = -1;
+                if (PRIM_SOCKETPAIR == id)
+                {
+                    _eventLoop.createSocketPair(first, second);
+                }
+                else
+                {
+                    _eventLoop.createPipe(first, second);
+                }
+                push(StackElement(StackElement::Number, first));
+                push(StackElement(StackElement::Number, second));
+            }
+            break;
+        case PRIM_TCP_LISTEN:
+            push(StackElement(StackElement::Number, _eventLoop.listenTcp(popNumber())));
+            break;
+        case PRIM_TCP_CONNECT:
+            push(StackElement(StackElement::Number, _eventLoop.connectTcp(popNumber())));
+            break;
+        case PRIM_UNIX_LISTEN:
+            push(StackElement(StackElement::Number, _eventLoop.listenUnix(popString())));
+            break;
+        case PRIM_UNIX_CONNECT:
+            push(StackElement(StackElement::Number, _eventLoop.connectUnix(popString())));
+            break;
+        case PRIM_LOCAL_PORT:
+            push(StackElement(StackElement::Number, _eventLoop.localPort(popNumber())));
+            break;
+        case PRIM_ON_ACCEPT:
+        case PRIM_ON_READ:
+        case PRIM_ON_READ_LINE:
+            {
+                StackElement quotation = popQuotation();
+                int fd = popNumber();
+                if (PRIM_ON_ACCEPT == id)
+                {
+                    _eventLoop.addAccept(fd, quotation);
+                }
+                else
+                {
+                    _eventLoop.addRead(fd, quotation, PRIM_ON_READ_LINE == id);
+                }
+            }
+            break;
+        case PRIM_WRITE_ASYNC:
+            {
+                StackElement quotation = popQuotation();
+                string data = popString();
+                int fd = popNumber();
+                _eventLoop.addWrite(fd, data, quotation);
+            }
+            break;
+        case PRIM_CLOSE:
+            _eventLoop.close(popNumber());
+            break;
+        case PRIM_RUN_LOOP:
+            runEventLoop();
+            break;
+        }
+    }
+
+    // Bulk words over packed arrays. The loops are the kernels in simd.cpp; an int64
+    // array meeting a double array, or a Double operand, is promoted to doubles first.
+    void Interpreter::dispatchArrayWord(WORD_ID id)
+    {
+        const char* word = PRIM_WORD_TO_STR_MAP.at(id).c_str();
+
+        auto popArray = [this, word]()
+        {
+            StackElement elem = pop();
+            if (elem.type() != StackElement::Array)
+            {
+                stringstream strBuilder;
+                strBuilder << "expected array for '" << word << "', got : ";
+                throwIfTypeUnexpected(elem, StackElement::Array, strBuilder.str());
+            }
+            return elem;
+        };
+
+        auto popNumber = [this]()
+        {
+            StackElement elem = pop();
+            throwIfTypeUnexpected(elem, StackElement::Number, "expected number, got : ");
+            return static_cast<int64_t>(elem.numberData());
+        };
+
+        // a Number or a Double; big numbers have no place in an array
+        auto popScalar = [this]()
+        {
+            StackElement elem = pop();
+            if (elem.type() != StackElement::Double)
+            {
+                throwIfTypeUnexpected(elem, StackElement::Number, "expected number, got : ");
+            }
+            return elem;
+        };
+
+        auto toDoubles = [](const NumericArray& arr)
+        {
+            auto ret = StackElement::makeArray(NumericArray::Double, arr.size());
+            for (size_t ii = 0; ii < arr.size(); ii++)
+            {
+                ret->doubles[ii] = arr.at(ii);
+            }
+            return ret;
+        };
+
+        auto pushNumber = [this](double value)
+        {
+            push(StackElement::makeDouble(value));
+        };
+
+        // element ii, as vnth pushes it
+        auto pushElement = [this, &pushNumber](const NumericArray& data, size_t ii)
+        {
+            if (data.kind == NumericArray::Int64)
+            {
+                push(StackElement(StackElement::Number, static_cast<long>(data.ints[ii])));
+            }
+            else
+            {
+                pushNumber(data.doubles[ii]);
+            }
+        };
+
+        auto append = [](NumericArray& to, const NumericArray& from, size_t ii)
+        {
+            if (from.kind == NumericArray::Int64)
+            {
+                to.ints.push_back(from.ints[ii]);
+            }
+            else
+            {
+                to.doubles.push_back(from.doubles[ii]);
+            }
+        };
+
+        switch (id)
+        {
+        case PRIM_TO_ARRAY:
+            {
+                StackElement quotation = popQuotation(word);
+                CodeVector body = quotation.flattenQuotation();
+                bool doubles = false;
+                for (size_t ii = 0; ii < body.size(); ii++)
+                {
+                    if (body[ii].type() != StackElement::Double)
+                    {
+                        throwIfTypeUnexpected(body[ii], StackElement::Number, "expected number in array literal, got : ");
+                    }
+                    doubles = doubles || body[ii].type() == StackElement::Double;
+                }
+
+                // any double makes it an array of doubles
+                auto arr = StackElement::makeArray(doubles ? NumericArray::Double : NumericArray::Int64, body.size());
+                for (size_t ii = 0; ii < body.size(); ii++)
+                {
+                    if (doubles)
+                    {
+                        arr->doubles[ii] = numeric::toDouble(body[ii]);
+                    }
+                    else
+                    {
+                        arr->ints[ii] = body[ii].numberData();
+                    }
+                }
+                push(StackElement(StackElement::Array, std::move(arr)));
+            }
+            break;
+        case PRIM_TO_DOUBLES:
+            {
+                StackElement arr = popArray();
+                if (arr.arrayData()->kind == NumericArray::Double)
+                {
+                    push(std::move(arr));
+                }
+                else
+                {
+                    push(StackElement(StackElement::Array, toDoubles(*arr.arrayData())));
+                }
+            }
+            break;
+        case PRIM_IOTA:
+            {
+                int64_t count = popNumber();
+                ThrofException::throwIfTrue(count < 0, "Interpreter", "iota count must not be negative");
+                auto arr = StackElement::makeArray(NumericArray::Int64, static_cast<size_t>(count));
+                for (int64_t ii = 0; ii < count; ii++)
+                {
+                    arr->ints[ii] = ii;
+                }
+                push(StackElement(StackElement::Array, std::move(arr)));
+            }
+            break;
+        case PRIM_VLENGTH:
+            push(StackElement(StackElement::Number, static_cast<long>(popArray().arrayData()->size())));
+            break;
+        case PRIM_VNTH:
+            {
+                int64_t index = popNumber();
+                StackElement arr = popArray();
+                const NumericArray& data = *arr.arrayData();
+                if (index < 0 || static_cast<size_t>(index) >= data.size())
+                {
+                    stringstream strBuilder;
+                    strBuilder << "index " << index << " out of range for array of length " << data.size();
+                    throw ThrofException("Interpreter", strBuilder.str(), _filename);
+                }
+                pushElement(data, static_cast<size_t>(index));
+            }
+            break;
+        case PRIM_VADD:
+        case PRIM_VMUL:
+        case PRIM_VDOT:
+            {
+                StackElement right = popArray();
+                StackElement left = popArray();
+                shared_ptr<const NumericArray> l, r;
+                const NumericArray* a = left.arrayData();
+                const NumericArray* b = right.arrayData();
+                if (a->size() != b->size())
+                {
+                    stringstream strBuilder;
+                    strBuilder << "array length mismatch for '" << word << "' : " << a->size() << " <> " << b->size();
+                    throw ThrofException("Interpreter", strBuilder.str(), _filename);
+                }
+
+                // promote the int64 side when the kinds differ
+                if (a->kind != b->kind)
+                {
+                    if (a->kind == NumericArray::Int64)
+                    {
+                        l = toDoubles(*a);
+                        a = l.get();
+                    }
+                    else
+                    {
+                        r = toDoubles(*b);
+                        b = r.get();
+                    }
+                }
+
+                size_t count = a->size();
+                if (a->kind == NumericArray::Int64)
+                {
+                    if (PRIM_VDOT == id)
+                    {
+                        push(StackElement(StackElement::Number, static_cast<long>(simd::dotInt64(a->ints.data(), b->ints.data(), count))));
+                        break;
+                    }
+
+                    auto out = StackElement::makeArray(NumericArray::Int64, count);
+                    (PRIM_VADD == id ? simd::addInt64 : simd::mulInt64)(a->ints.data(), b->ints.data(), out->ints.data(), count);
+                    push(StackElement(StackElement::Array, std::move(out)));
+                }
+                else
+                {
+                    if (PRIM_VDOT == id)
+                    {
+                        pushNumber(simd::dotDouble(a->doubles.data(), b->doubles.data(), count));
+                        break;
+                    }
+
+                    auto out = StackElement::makeArray(NumericArray::Double, count);
+                    (PRIM_VADD == id ? simd::addDouble : simd::mulDouble)(a->doubles.data(), b->doubles.data(), out->doubles.data(), count);
+                    push(StackElement(StackElement::Array, std::move(out)));
+                }
+            }
+            break;
+        case PRIM_VSUM:
+        case PRIM_VMIN:
+        case PRIM_VMAX:
+            {
+                StackElement arr = popArray();
+                const NumericArray& data = *arr.arrayData();
+                if (PRIM_VSUM != id && 0 == data.size())
+                {
+                    stringstream strBuilder;
+                    strBuilder << "'" << word << "' of an empty array";
+                    throw ThrofException("Interpreter", strBuilder.str(), _filename);
+                }
+
+                if (data.kind == NumericArray::Int64)
+                {
+                    int64_t result = PRIM_VSUM == id ? simd::sumInt64(data.ints.data(), data.size())
+                        : (PRIM_VMIN == id ? simd::minInt64(data.ints.data(), data.size())
+                        : simd::maxInt64(data.ints.data(), data.size()));
+                    push(StackElement(StackElement::Number, static_cast<long>(result)));
+                }
+                else
+                {
+                    pushNumber(PRIM_VSUM == id ? simd::sumDouble(data.doubles.data(), data.size())
+                        : (PRIM_VMIN == id ? simd::minDouble(data.doubles.data(), data.size())
+                        : simd::maxDouble(data.doubles.data(), data.size())));
+                }
+            }
+            break;
+        case PRIM_VMAP_AFFINE:
+            {
+                // arr a b vmap-affine computes a * x + b for every x
+                StackElement offset = popScalar();
+                StackElement scale = popScalar();
+                StackElement arr = popArray();
+                shared_ptr<const NumericArray> promoted;
+                const NumericArray* data = arr.arrayData();
+                if (data->kind == NumericArray::Int64 && (offset.type() == StackElement::Double || scale.type() == StackElement::Double))
+                {
+                    promoted = toDoubles(*data);
+                    data = promoted.get();
+                }
+
+                auto out = StackElement::makeArray(data->kind, data->size());
+                if (data->kind == NumericArray::Int64)
+                {
+                    simd::affineInt64(data->ints.data(), scale.numberData(), offset.numberData(), out->ints.data(), data->size());
+                }
+                else
+                {
+                    simd::affineDouble(data->doubles.data(), numeric::toDouble(scale), numeric::toDouble(offset), out->doubles.data(), data->size());
+                }
+                push(StackElement(StackElement::Array, std::move(out)));
+            }
+            break;
+        case PRIM_SORT:
+        case PRIM_UNIQUE:
+            {
+                // unique drops repeats of the element before, so on a sorted array
+                // it leaves the distinct values
+                StackElement arr = popArray();
+                const NumericArray& data = *arr.arrayData();
+                auto out = StackElement::makeArray(data.kind, 0);
+                out->ints.assign(data.ints.begin(), data.ints.end());
+                out->doubles.assign(data.doubles.begin(), data.doubles.end());
+                if (PRIM_SORT == id)
+                {
+                    parallelsort::sort(out->ints.data(), out->ints.size(), std::less<int64_t>());
+                    parallelsort::sort(out->doubles.data(), out->doubles.size(), parallelsort::doubleLess);
+                }
+                else
+                {
+                    out->ints.erase(std::unique(out->ints.begin(), out->ints.end()), out->ints.end());
+                    out->doubles.erase(std::unique(out->doubles.begin(), out->doubles.end()), out->doubles.end());
+                }
+                push(StackElement(StackElement::Array, std::move(out)));
+            }
+            break;
+        case PRIM_SORT_BY:
+            {
+                // arr [ key ] sort-by orders by the number the quotation leaves for each
+                // element. Keys are computed once each; ties keep their original order.
+                StackElement quotation = popQuotation(word);
+                StackElement arr = popArray();
+                const NumericArray& data = *arr.arrayData();
+
+                // keys are compared as int64s unless one of them is a Double
+                typedef pair<int64_t, size_t> KeyedIndex;
+                typedef pair<double, size_t> DoubleKeyedIndex;
+                vector<KeyedIndex, ResourceAllocator<KeyedIndex>> keyed;
+                vector<DoubleKeyedIndex, ResourceAllocator<DoubleKeyedIndex>> doubleKeyed;
+                keyed.reserve(data.size());
+                for (size_t ii = 0; ii < data.size(); ii++)
+                {
+                    pushElement(data, ii);
+                    callQuotation(quotation);
+                    StackElement key = pop();
+                    if (key.type() != StackElement::Double)
+                    {
+                        throwIfTypeUnexpected(key, StackElement::Number, "expected number key for 'sort-by', got : ");
+                    }
+
+                    if (key.type() == StackElement::Double && doubleKeyed.empty())
+                    {
+                        doubleKeyed.reserve(data.size());
+                        for (auto itr = keyed.cbegin(); itr != keyed.cend(); itr++)
+                        {
+                            doubleKeyed.push_back(DoubleKeyedIndex(static_cast<double>((*itr).first), (*itr).second));
+                        }
+                    }
+
+                    if (doubleKeyed.empty())
+                    {
+                        keyed.push_back(KeyedIndex(key.numberData(), ii));
+                    }
+                    else
+                    {
+                        doubleKeyed.push_back(DoubleKeyedIndex(numeric::toDouble(key), ii));
+                    }
+                }
+
+                vector<size_t> order;
+                order.reserve(data.size());
+                if (doubleKeyed.empty())
+                {
+                    parallelsort::sort(keyed.data(), keyed.size(), std::less<KeyedIndex>());
+                    for (auto itr = keyed.cbegin(); itr != keyed.cend(); itr++)
+                    {
+                        order.push_back((*itr).second);
+                    }
+                }
+                else
+                {
+                    parallelsort::sort(doubleKeyed.data(), doubleKeyed.size(), [](const DoubleKeyedIndex& left, const DoubleKeyedIndex& right)
+                    {
+                        return parallelsort::doubleLess(left.first, right.first)
+                            || (!parallelsort::doubleLess(right.first, left.first) && left.second < right.second);
+                    });
+                    for (auto itr = doubleKeyed.cbegin(); itr != doubleKeyed.cend(); itr++)
+                    {
+                        order.push_back((*itr).second);
+                    }
+                }
+
+                auto out = StackElement::makeArray(data.kind, 0);
+                out->ints.reserve(data.kind == NumericArray::Int64 ? data.size() : 0);
+                out->doubles.reserve(data.kind == NumericArray::Double ? data.size() : 0);
+                for (auto itr = order.cbegin(); itr != order.cend(); itr++)
+                {
+                    append(*out, data, *itr);
+                }
+                push(StackElement(StackElement::Array, std::move(out)));
+            }
+            break;
+        case PRIM_BINARY_SEARCH:
+            {
+                // sorted-arr x binary-search leaves the index of the first element not
+                // less than x and whether that element is x
+                StackElement value = popScalar();
+                StackElement arr = popArray();
+                const NumericArray& data = *arr.arrayData();
+                size_t index = 0;
+                bool found = false;
+                if (data.kind == NumericArray::Int64 && value.type() == StackElement::Number)
+                {
+                    auto itr = std::lower_bound(data.ints.begin(), data.ints.end(), value.numberData());
+                    index = itr - data.ints.begin();
+                    found = itr != data.ints.end() && *itr == value.numberData();
+                }
+                else if (data.kind == NumericArray::Int64)
+                {
+                    double x = value.doubleData();
+                    auto itr = std::lower_bound(data.ints.begin(), data.ints.end(), x, [](int64_t element, double target)
+                    {
+                        return static_cast<double>(element) < target;
+                    });
+                    index = itr - data.ints.begin();
+                    found = itr != data.ints.end() && static_cast<double>(*itr) == x;
+                }
+                else
+                {
+                    double x = numeric::toDouble(value);
+                    auto itr = std::lower_bound(data.doubles.begin(), data.doubles.end(), x, parallelsort::doubleLess);
+                    index = itr - data.doubles.begin();
+                    found = itr != data.doubles.end() && *itr == x;
+                }
+                push(StackElement(StackElement::Number, static_cast<long>(index)));
+                push(StackElement(StackElement::Boolean, StackElement::BooleanType(found)));
+            }
+            break;
+        case PRIM_PARTITION:
+            {
+                // arr [ pred ] partition leaves the elements pred holds for and the rest,
+                // both in their original order
+                StackElement quotation = popQuotation(word);
+                StackElement arr = popArray();
+                const NumericArray& data = *arr.arrayData();
+                auto matching = StackElement::makeArray(data.kind, 0);
+                auto rest = StackElement::makeArray(data.kind, 0);
+                for (size_t ii = 0; ii < data.size(); ii++)
+                {
+                    pushElement(data, ii);
+                    callQuotation(quotation);
+                    StackElement verdict = pop();
+                    throwIfTypeUnexpected(verdict, StackElement::Boolean, "expected boolean from 'partition' predicate, got : ");
+                    append(verdict.booleanData() ? *matching : *rest, data, ii);
+                }
+                push(StackElement(StackElement::Array, std::move(matching)));
+                push(StackElement(StackElement::Array, std::move(rest)));
+            }
+            break;
+        }
+    }
+
+    // String words. Slices share the buffer of the string they came from, and concat
+    // builds a rope that is only copied out flat when its bytes are needed, so none of
+    // these copy the text except join, which copies each piece once.
+    //   length  ( s -- n )
+    //   concat  ( s1 s2 -- s )
+    //   subseq  ( s from to -- s' )       bytes from up to, not including, to
+    //   head    ( s n -- s' )             the first n bytes
+    //   tail    ( s n -- s' )             all but the first n bytes
+    //   find    ( s pattern -- index ? )  index is -1 when pattern does not occur
+    //   split   ( s separator -- [ pieces ] )
+    //   join    ( [ pieces ] separator -- s )
+    void Interpreter::dispatchStringWord(WORD_ID id)
+    {
+        const char* word = PRIM_WORD_TO_STR_MAP.at(id).c_str();
+
+        auto popString = [this, word]()
+        {
+            StackElement elem = pop();
+            if (elem.type() != StackElement::String)
+            {
+                stringstream strBuilder;
+                strBuilder << "expected string for '" << word << "', got : ";
+                throwIfTypeUnexpected(elem, StackElement::String, strBuilder.str());
+            }
+            return elem;
+        };
+
+        // an offset into str, which may be its length but not past it
+        auto toOffset = [this, word](const StackElement& elem, const StackElement& str)
+        {
+            throwIfTypeUnexpected(elem, StackElement::Number, "expected number, got : ");
+            int64_t offset = elem.numberData();
+            if (offset < 0 || static_cast<uint64_t>(offset) > str.stringLength())
+            {
+                stringstream strBuilder;
+                strBuilder << "offset " << offset << " out of range for '" << word << "' on string of length " << str.stringLength();
+                throw ThrofException("Interpreter", strBuilder.str(), _filename);
+            }
+            return static_cast<size_t>(offset);
+        };
+
+        switch (id)
+        {
+        case PRIM_LENGTH:
+            push(StackElement(StackElement::Number, static_cast<int64_t>(popString().stringLength())));
+            break;
+        case PRIM_CONCAT:
+            {
+                StackElement right = popString();
+                StackElement left = popString();
+                push(StackElement::concat(left, right));
+            }
+            break;
+        case PRIM_SUBSEQ:
+            {
+                StackElement to = pop();
+                StackElement from = pop();
+                StackElement str = popString();
+                size_t begin = toOffset(from, str);
+                size_t end = toOffset(to, str);
+                if (end < begin)
+                {
+                    stringstream strBuilder;
+                    strBuilder << "subseq end " << end << " is before its start " << begin;
+                    throw ThrofException("Interpreter", strBuilder.str(), _filename);
+                }
+                push(str.slice(begin, end - begin));
+            }
+            break;
+        case PRIM_HEAD:
+        case PRIM_TAIL:
+            {
+                StackElement count = pop();
+                StackElement str = popString();
+                size_t split = toOffset(count, str);
+                push(PRIM_HEAD == id ? str.slice(0, split) : str.slice(split, str.stringLength() - split));
+            }
+            break;
+        case PRIM_FIND:
+            {
+                StackElement pattern = popString();
+                StackElement str = popString();
+                StringView haystack = str.stringData(), needle = pattern.stringData();
+                const char* found = std::search(haystack.data, haystack.data + haystack.size, needle.data, needle.data + needle.size);
+                bool ret = found != haystack.data + haystack.size || needle.size == 0;
+                push(StackElement(StackElement::Number, ret ? static_cast<int64_t>(found - haystack.data) : -1));
+                push(StackElement(StackElement::Boolean, StackElement::BooleanType(ret)));
+            }
+            break;
+        case PRIM_SPLIT:
+            {
+                StackElement separator = popString();
+                StackElement str = popString();
+                StringView text = str.stringData(), sep = separator.stringData();
+                if (sep.size == 0)
+                {
+                    throw ThrofException("Interpreter", "empty separator for 'split'", _filename);
+                }
+
+                // n separators make n + 1 pieces, empty ones included
+                CodeVector pieces;
+                size_t begin = 0;
+                while (true)
+                {
+                    const char* found = std::search(text.data + begin, text.data + text.size, sep.data, sep.data + sep.size);
+                    size_t end = found - text.data;
+                    pieces.push_back(str.slice(begin, end - begin));
+                    if (end == text.size)
+                    {
+                        break;
+                    }
+                    begin = end + sep.size;
+                }
+                push(StackElement(StackElement::Quotation, std::move(pieces)));
+            }
+            break;
+        case PRIM_JOIN:
+            {
+                StackElement separator = popString();
+                StackElement quotation = popQuotation(word);
+                CodeVector flattened;
+                const CodeVector& pieces = (nullptr != quotation.closure()) ? (flattened = quotation.flattenQuotation()) : quotation.quotationData();
+
+                StringView sep = separator.stringData();
+                size_t length = 0;
+                for (auto itr = pieces.cbegin(); itr != pieces.cend(); itr++)
+                {
+                    throwIfTypeUnexpected(*itr, StackElement::String, "expected strings to 'join', got : ");
+                    length += (*itr).stringLength() + (itr != pieces.cbegin() ? sep.size : 0);
+                }
+
+                string joined;
+                joined.reserve(length);
+                for (auto itr = pieces.cbegin(); itr != pieces.cend(); itr++)
+                {
+                    if (itr != pieces.cbegin())
+                    {
+                        joined.append(sep.data, sep.size);
+                    }
+                    StringView piece = (*itr).stringData();
+                    joined.append(piece.data, piece.size);
+                }
+                push(StackElement(StackElement::String, joined));
+            }
+            break;
+        }
+    }
+
+    // Hash map words. Maps are shared, not copied: set-at and delete-at change the map
+    // every copy of it refers to.
+    //   <hashmap>   ( -- map )
+    //   at          ( key map -- value ? )   value is false when key is not in the map
+    //   set-at      ( value key map -- )
+    //   delete-at   ( key map -- )
+    //   keys        ( map -- [ keys ] )      in the order they were added
+    //   each-entry  ( map quot -- )          quot: ( key value -- )
+    void Interpreter::dispatchMapWord(WORD_ID id)
+    {
+        const char* word = PRIM_WORD_TO_STR_MAP.at(id).c_str();
+
+        auto popMap = [this, word]()
+        {
+            StackElement elem = pop();
+            if (elem.type() != StackElement::Map)
+            {
+                stringstream strBuilder;
+                strBuilder << "expected hashmap for '" << word << "', got : ";
+                throwIfTypeUnexpected(elem, StackElement::Map, strBuilder.str());
+            }
+            return elem;
+        };
+
+        auto popKey = [this, word]()
+        {
+            StackElement elem = pop();
+            if (!HashMap::isKey(elem))
+            {
+                stringstream strBuilder;
+                strBuilder << "expected number, boolean or string as key for '" << word << "', got : ";
+                throwIfTypeUnexpected(elem, StackElement::String, strBuilder.str());
+            }
+            return elem;
+        };
+
+        switch (id)
+        {
+        case PRIM_NEW_HASHMAP:
+            {
+                // long lived from the start, like the values of variables
+                ResourceAllocator<char> allocator(_memoryResource);
+                push(StackElement(StackElement::Map, allocate_shared<HashMap>(ResourceAllocator<HashMap>(allocator), allocator)));
+            }
+            break;
+        case PRIM_AT:
+            {
+                StackElement map = popMap();
+                StackElement key = popKey();
+                const StackElement* value = map.mapData()->find(key);
+                push(nullptr != value ? *value : StackElement(StackElement::Boolean, StackElement::BooleanType(false)));
+                push(StackElement(StackElement::Boolean, StackElement::BooleanType(nullptr != value)));
+            }
+            break;
+        case PRIM_SET_AT:
+            {
+                StackElement map = popMap();
+                StackElement key = popKey();
+                StackElement value = pop();
+                map.mapData()->set(key, value);
+            }
+            break;
+        case PRIM_DELETE_AT:
+            {
+                StackElement map = popMap();
+                StackElement key = popKey();
+                map.mapData()->erase(key);
+            }
+            break;
+        case PRIM_KEYS:
+            {
+                StackElement map = popMap();
+                const HashMap::Entries& entries = map.mapData()->entries();
+                CodeVector keys;
+                keys.reserve(map.mapData()->size());
+                for (auto itr = entries.cbegin(); itr != entries.cend(); itr++)
                 {
-                case StackElement::Boolean:
-                case StackElement::Number:
-                case StackElement::String:
-                case StackElement::Variable:
-                case StackElement::Quotation:
-                    _stack.push_back(StackElement(innerElem));
+                    if ((*itr).live)
+                    {
+                        keys.push_back((*itr).key);
+                    }
+                }
+                push(StackElement(StackElement::Quotation, std::move(keys)));
+            }
+            break;
+        case PRIM_EACH_ENTRY:
+            {
+                StackElement quotation = popQuotation(word);
+                StackElement map = popMap();
+
+                // the quotation may change the map, so it walks a copy of the entries
+                std::vector<StackElement> snapshot;
+                const HashMap::Entries& entries = map.mapData()->entries();
+                snapshot.reserve(map.mapData()->size() * 2);
+                for (auto itr = entries.cbegin(); itr != entries.cend(); itr++)
+                {
+                    if ((*itr).live)
+                    {
+                        snapshot.push_back((*itr).key);
+                        snapshot.push_back((*itr).value);
+                    }
+                }
+
+                for (size_t ii = 0; ii < snapshot.size(); ii += 2)
+                {
+                    push(snapshot[ii]);
+                    push(snapshot[ii + 1]);
+                    callQuotation(quotation);
+                }
+            }
+            break;
+        }
+    }
+
+    // The primitives behind the words :tuple declares, which are compiled to a reference
+    // to one of these carrying the class and slot it was declared for:
+    //   <name>   ( slot values... -- tuple )
+    //   name?    ( obj -- ? )
+    //   slot>>   ( tuple -- value )
+    //   >>slot   ( tuple value -- tuple )      changes the tuple in place
+    // An accessor given a tuple of another class looks its slot up by name, so x>> works
+    // on any tuple with a slot x.
+    void Interpreter::dispatchTupleWord(const StackElement& word)
+    {
+        WORD_ID id = word.wordRefId();
+        size_t classId = static_cast<size_t>(word.numberData());
+        if (classId >= _tupleClasses.size())
+        {
+            stringstream strBuilder;
+            strBuilder << "'" << word.wordName() << "' is only run through the words :tuple declares";
+            throw ThrofException("Interpreter", strBuilder.str(), _filename);
+        }
+
+        auto popTuple = [this, &word]()
+        {
+            StackElement elem = pop();
+            if (elem.type() != StackElement::Tuple)
+            {
+                stringstream strBuilder;
+                strBuilder << "expected tuple for '" << word.wordName() << "', got : ";
+                throwIfTypeUnexpected(elem, StackElement::Tuple, strBuilder.str());
+            }
+            return elem;
+        };
+
+        auto slotOf = [this, &word, classId](const TupleValue& tuple) -> size_t
+        {
+            size_t slot = static_cast<size_t>(word.wordRefCurrentOffset());
+            if (tuple.classId == classId)
+            {
+                return slot;
+            }
+
+            const string& name = _tupleClasses[classId].slots[slot];
+            const TupleClass& tupleClass = _tupleClasses[tuple.classId];
+            auto found = std::find(tupleClass.slots.cbegin(), tupleClass.slots.cend(), name);
+            if (found == tupleClass.slots.cend())
+            {
+                stringstream strBuilder;
+                strBuilder << "tuple '" << tupleClass.name << "' has no slot '" << name << "' for '" << word.wordName() << "'";
+                throw ThrofException("Interpreter", strBuilder.str(), _filename);
+            }
+            return found - tupleClass.slots.cbegin();
+        };
+
+        switch (id)
+        {
+        case PRIM_NEW_TUPLE:
+            {
+                size_t count = _tupleClasses[classId].slots.size();
+                if (_stack.size() < count)
+                {
+                    throw ThrofException("Interpreter", "stack underflow", _filename);
+                }
+
+                // long lived from the start, like maps; copies are made from the default
+                // resource, see PRIM_SET
+                DefaultResourceScope scope(_memoryResource);
+                ResourceAllocator<char> allocator(_memoryResource);
+                auto tuple = allocate_shared<TupleValue>(ResourceAllocator<TupleValue>(allocator), classId, count, allocator);
+                for (size_t ii = 0; ii < count; ii++)
+                {
+                    StackElement& slot = tuple->slots[ii];
+                    slot = _stack[_stack.size() - count + ii];
+                    slot.unshare();
+                }
+                for (size_t ii = 0; ii < count; ii++)
+                {
+                    pop();
+                }
+                push(StackElement(StackElement::Tuple, std::move(tuple)));
+            }
+            break;
+        case PRIM_IS_TUPLE:
+            {
+                StackElement elem = pop();
+                bool ret = elem.type() == StackElement::Tuple && elem.tupleData()->classId == classId;
+                push(StackElement(StackElement::Boolean, StackElement::BooleanType(ret)));
+            }
+            break;
+        case PRIM_SLOT_GET:
+            {
+                StackElement tuple = popTuple();
+                push(tuple.tupleData()->slots[slotOf(*tuple.tupleData())]);
+            }
+            break;
+        case PRIM_SLOT_SET:
+            {
+                StackElement value = pop();
+                StackElement tuple = popTuple();
+                size_t slot = slotOf(*tuple.tupleData());
+                {
+                    DefaultResourceScope scope(_memoryResource);
+                    StackElement stored(value);
+                    stored.unshare();
+                    tuple.tupleData()->slots[slot] = std::move(stored);
+                }
+                push(std::move(tuple));
+            }
+            break;
+        }
+    }
+
+    // Runs completions until nothing is left pending. Each completion pushes its
+    // results and resumes the quotation that was registered with the operation:
+    //   on-accept     ( fd quot -- )   quot: ( client-fd -- )
+    //   on-read       ( fd quot -- )   quot: ( str ? -- )     ? is false at end of stream
+    //   on-read-line  ( fd quot -- )   quot: ( line ? -- )
+    //   write-async   ( fd str quot -- ) quot: ( ? -- )       ? is false if the write failed
+    void Interpreter::runEventLoop()
+    {
+        vector<EventLoop::Completion> completions;
+        while (_eventLoop.hasPending())
+        {
+            completions.clear();
+            _eventLoop.poll(completions);
+
+            for (auto itr = completions.begin(); itr != completions.end(); itr++)
+            {
+                const EventLoop::Completion& completion = *itr;
+                switch (completion.type)
+                {
+                case EventLoop::Accept:
+                    push(StackElement(StackElement::Number, completion.fd));
                     break;
-                case StackElement::WordReference:
-                    dispatch(innerElem);
+                case EventLoop::Read:
+                case EventLoop::ReadLine:
+                    push(StackElement(StackElement::String, completion.data));
+                    push(StackElement(StackElement::Boolean,
+                        StackElement::BooleanType(completion.success)));
                     break;
-                case StackElement::Nil:
-                default:
+                case EventLoop::Write:
+                    push(StackElement(StackElement::Boolean,
+                        StackElement::BooleanType(completion.success)));
+                    break;
+                }
+
+                callQuotation(completion.quotation);
+            }
+        }
+    }
+
+    StackElement Interpreter::createStackElementFromToken(Tokenizer& tokenizer, const Token& tok)
+    {
+        if (tok.getType() == Token::TokenType::StringLiteral)
+        {
+            // ohai, it's a string literal, even if it spells a number or a boolean
+            //
+            // escaped quotations are not really supported yet...
+            return StackElement::intern(tok.getData());
+        }
+
+        StackElement number;
+        bool isNum = numeric::parse(tok.getData(), number);
+        bool isTrueToken = (0 == tok.getData().compare("true"));
+        auto local = std::find(_compilingLocals.cbegin(), _compilingLocals.cend(), tok.getData());
+        if (isTrueToken || 0 == tok.getData().compare("false"))
+        {
+            return StackElement(StackElement::Boolean,
+                StackElement::BooleanType(isTrueToken));
+        }
+        else if (isNum)
+        {
+            // ohai, it's a number
+            return number;
+        }
+        else if (tok.getType() == Token::TokenType::QuotationOpen)
+        {
+            CodeVector quotation((ResourceAllocator<StackElement>(&_compileArena)));
+            while (tokenizer.hasNextToken())
+            {
+                Token nextTok = tokenizer.getNextToken();
+
+                if (nextTok.getType() == Token::TokenType::QuotationClose)
+                {
                     break;
                 }
+
+                quotation.push_back(createStackElementFromToken(tokenizer, nextTok));
+            }
+
+            return StackElement(StackElement::Quotation, std::move(quotation));
+        }
+        else if (local != _compilingLocals.cend() && tok.getType() == Token::TokenType::WordOrData)
+        {
+            // locals hide words of the same name
+            int slot = static_cast<int>(local - _compilingLocals.cbegin());
+            return StackElement::makeBoundPrimitive(tok.getData(), PRIM_LOCAL, _compilingDefinition, slot);
+        }
+        else if (contains(_stringToWordDict, tok.getData()))
+        {
+            if (contains(_variablesInScope, tok.getData()))
+            {
+                return StackElement::makeVariable(tok.getData(), _stringToWordDict[tok.getData()]);
+            }
+
+            return createWordReference(tok.getData());
+        }
+        else
+        {
+            stringstream strBuilder;
+            strBuilder << "'" << tok.getData() << "' (type: " << tok.getType() << ") is not a defined word or valid data type";
+            throw ThrofException("Interpreter", strBuilder.str().c_str(), _filename);
+        }
+    }
+
+    void Interpreter::startProfiling()
+    {
+        _profiler.start();
+    }
+
+    // Prints the per-word table and writes the folded call stacks next to it.
+    void Interpreter::reportProfile()
+    {
+        Profiler::WordNames names = wordNames();
+        _profiler.report(cout, names);
+        _profiler.writeFoldedStacks(PROFILE_FOLDED_FILENAME, names);
+    }
+
+    void Interpreter::startSampling(int frequency)
+    {
+        _sampler.start(frequency);
+    }
+
+    void Interpreter::reportSamples()
+    {
+        Sampler::WordNames names = wordNames();
+        _sampler.report(cout, names);
+        _sampler.writeFoldedStacks(SAMPLE_FOLDED_FILENAME, names);
+    }
+
+    void Interpreter::startTracing(const string& filename)
+    {
+        _tracer.start(filename);
+    }
+
+    void Interpreter::stopTracing()
+    {
+        _tracer.stop(wordNames());
+    }
+
+    StackElement Interpreter::createWordReference(const string& name)
+    {
+        if (!contains(_stringToWordDict, name))
+        {
+            stringstream strBuilder;
+            strBuilder << "'" << name << "' is not a defined word";
+            throw ThrofException("Interpreter", strBuilder.str(), _filename);
+        }
+
+        WORD_ID id = _stringToWordDict[name];
+        int currentScopeWordDef = _dictionary[id].size() == 0 ? 0 : _dictionary[id].size() - 1;
+
+        // constants are compiled to their value
+        if (contains(_constants, name))
+        {
+            return _dictionary[id].back().front();
+        }
+
+        // the words :tuple generates are compiled to their body, a tuple primitive
+        // that already knows its class and slot
+        if (!_dictionary[id].empty())
+        {
+            const CodeVector& def = _dictionary[id].back();
+            if (def.size() == 1 && def[0].type() == StackElement::WordReference &&
+                def[0].wordRefId() >= PRIM_NEW_TUPLE && def[0].wordRefId() <= PRIM_SLOT_SET)
+            {
+                return def[0];
+            }
+        }
+
+        return StackElement(StackElement::WordReference, name, id, currentScopeWordDef);
+    }
+
+    // Batch mode: runs recordWord once per input record with the record on the stack,
+    // then finishWord (if the script defines it) once the input is exhausted. The stack
+    // carries over from one record to the next so scripts can accumulate results.
+    void Interpreter::processRecords(RecordReader& records, const string& recordWord, const string& finishWord)
+    {
+        DefaultResourceScope scope(_scratchResource);
+        StackElement word = createWordReference(recordWord);
+
+        const char* begin = nullptr;
+        const char* end = nullptr;
+        try
+        {
+            while (records.next(begin, end))
+            {
+                push(StackElement(StackElement::String, begin, end - begin));
+                dispatch(word);
+            }
+
+            if (contains(_stringToWordDict, finishWord))
+            {
+                dispatch(createWordReference(finishWord));
+            }
+        }
+        catch (const QuotaExceeded& e)
+        {
+            rethrowWithFilename(e);
+        }
+    }
+
+    void Interpreter::setMemoryResource(MemoryResource* resource)
+    {
+        _memoryResource = resource;
+        _scratchResource = resource;
+    }
+
+    // The instruction, stack depth and time limits count from here. The memory limit
+    // wraps the current memory resource, so it is meant to be set once, before anything
+    // runs under it.
+    void Interpreter::setLimits(const Quota::Limits& limits)
+    {
+        if (limits.memoryBytes > 0)
+        {
+            _memoryLimit.reset(new LimitedResource(limits.memoryBytes, _memoryResource));
+            setMemoryResource(_memoryLimit.get());
+
+            // the data stack and the locals grow under the limit too
+            auto rebind = [this](CodeVector& elements)
+            {
+                CodeVector limited((ResourceAllocator<StackElement>(_memoryResource)));
+                limited.reserve(elements.size());
+                limited.insert(limited.end(), make_move_iterator(elements.begin()), make_move_iterator(elements.end()));
+                elements = std::move(limited);
+            };
+            rebind(_stack);
+            rebind(_locals);
+        }
+        _quota.start(limits);
+    }
+
+    // Runs a request with its runtime values allocated from scratch, which the caller can
+    // throw away afterwards in one go. Whatever the request leaves behind on the stack or
+    // in the event loop is copied back into long lived memory first.
+    void Interpreter::evaluate(Tokenizer& tokenizer, MemoryResource* scratch)
+    {
+        // every evaluation gets the full quota, memory included
+        const Quota::Limits& limits = _quota.limits();
+        LimitedResource limitedScratch(limits.memoryBytes > 0 ? limits.memoryBytes : SIZE_MAX, scratch);
+        _quota.start(limits);
+
+        _scratchResource = &limitedScratch;
+        try
+        {
+            loadFile(tokenizer);
+        }
+        catch (const QuotaExceeded& e)
+        {
+            rehomeRuntimeValues();
+            rethrowWithFilename(e);
+        }
+        catch (...)
+        {
+            rehomeRuntimeValues();
+            throw;
+        }
+        rehomeRuntimeValues();
+    }
+
+    void Interpreter::rehomeRuntimeValues()
+    {
+        _scratchResource = _memoryResource;
+        DefaultResourceScope scope(_memoryResource);
+
+        // copies are allocated from the default resource, moving them back swaps it in
+        auto rehome = [](StackElement& elem)
+        {
+            StackElement copy(elem);
+            copy.unshare();
+            elem = std::move(copy);
+        };
+
+        for (auto itr = _stack.begin(); itr != _stack.end(); itr++)
+        {
+            rehome(*itr);
+        }
+
+        vector<StackElement*> waiting;
+        _eventLoop.pendingQuotations(waiting);
+        for (auto itr = waiting.begin(); itr != waiting.end(); itr++)
+        {
+            rehome(**itr);
+        }
+    }
+
+    void Interpreter::addWordToDictionary(Tokenizer& tokenizer, const string& s, bool hasLocals)
+    {
+        CodeVector ret((ResourceAllocator<StackElement>(&_compileArena)));
+        Token tok = tokenizer.getNextToken();
+
+        // The inputs of a :: word come first. The definition starts with bind-locals,
+        // which moves them into a frame of their own, and every use of one by name
+        // reads its slot in that frame. Quotations get their values when they are
+        // pushed, see captureLocals.
+        struct CompilingLocals
+        {
+            vector<string>& names;
+            ~CompilingLocals() { names.clear(); }
+        } compilingLocals = { _compilingLocals };
+
+        if (hasLocals)
+        {
+            _compilingDefinition = ++_localsDefinitions;
+            while (tok.getType() == Token::LocalName)
+            {
+                StackElement literal;
+                const vector<string>& names = _compilingLocals;
+                if (numeric::parse(tok.getData(), literal) || 0 == tok.getData().compare("true") || 0 == tok.getData().compare("false") ||
+                    std::find(names.cbegin(), names.cend(), tok.getData()) != names.cend())
+                {
+                    stringstream errBuilder;
+                    errBuilder << "'" << tok.getData() << "' is not a valid input name for word '" << s << "'";
+                    throw ThrofException("Interpreter", errBuilder.str(), tokenizer.filename());
+                }
+                _compilingLocals.push_back(tok.getData());
+
+                if (!tokenizer.hasNextToken())
+                {
+                    stringstream errBuilder;
+                    errBuilder << "word definition terminator (' ; ') expected at end of word '" << s << "'";
+                    throw ThrofException("Interpreter", errBuilder.str(), tokenizer.filename());
+                }
+                tok = tokenizer.getNextToken();
+            }
+            ret.push_back(StackElement::makeBoundPrimitive(PRIM_BIND_LOCALS_STR, PRIM_BIND_LOCALS, _compilingDefinition, static_cast<int>(_compilingLocals.size())));
+        }
+
+        while (tok.getType() != Token::DefinitionTerminator)
+        {
+            StackElement elem = createStackElementFromToken(tokenizer, tok);
+            bool capture = hasLocals && elem.type() == StackElement::Quotation && usesLocals(elem.quotationData(), _compilingDefinition);
+            appendFolded(ret, std::move(elem));
+            if (capture)
+            {
+                ret.push_back(StackElement::makeBoundPrimitive(PRIM_CAPTURE_LOCALS_STR, PRIM_CAPTURE_LOCALS, _compilingDefinition, 0));
+            }
+
+            if (tokenizer.hasNextToken())
+            {
+                tok = tokenizer.getNextToken();
+            }
+            else
+            {
+                stringstream errBuilder;
+                errBuilder << "word definition terminator (' ; ') expected at end of word '";
+                errBuilder << s << "'";
+                throw ThrofException("Interpreter", errBuilder.str(), tokenizer.filename());
             }
-            break;
         }
+
+        defineWord(s, std::move(ret));
     }
 
-    inline bool parse_number(const std::string& s, int& retParsedInt)
+    // Appends elem to the body of a definition. Arithmetic on two number literals, which
+    // is what constants turn into, is done here and compiled to its result. An integer
+    // division by zero is left to fail when it runs.
+    void Interpreter::appendFolded(CodeVector& code, StackElement elem)
     {
-        try
+        size_t size = code.size();
+        if (elem.type() != StackElement::WordReference || size < 2)
         {
-            size_t pos = 0;
-            retParsedInt = std::stoi(s, &pos);
-            if (pos != s.size())
-            {
-                return false;
-            }
-            return true;
+            code.push_back(std::move(elem));
+            return;
         }
-        catch (...)
+
+        WORD_ID id = elem.wordRefId();
+        bool arithmetic = (id == PRIM_ADD || id == PRIM_SUB || id == PRIM_MUL || id == PRIM_DIV || id == PRIM_MOD);
+        if (arithmetic && numeric::isNumeric(code[size - 2]) && numeric::isNumeric(code[size - 1]))
         {
-            return false;
+            const StackElement& left = code[size - 2];
+            const StackElement& right = code[size - 1];
+            bool divisionByZero = (id == PRIM_DIV || id == PRIM_MOD) && left.type() != StackElement::Double &&
+                right.type() == StackElement::Number && right.numberData() == 0;
+            if (!divisionByZero)
+            {
+                StackElement result = numeric::arithmetic(id, left, right, _filename);
+                code.pop_back();
+                code.back() = std::move(result);
+                return;
+            }
         }
+
+        code.push_back(std::move(elem));
     }
 
-    StackElement Interpreter::createStackElementFromToken(Tokenizer& tokenizer, const Token& tok)
+    // Makes code the latest definition of s, or its only one if s was deferred.
+    void Interpreter::defineWord(const string& s, CodeVector code)
     {
-        int numVal;
-        bool isNum = parse_number(tok.getData(), numVal);
-        bool isTrueToken = (0 == tok.getData().compare("true"));
-        if (isTrueToken || 0 == tok.getData().compare("false"))
+        _constants.erase(s);
+
+        WORD_ID id;
+        if (contains(_stringToWordDict, s))
         {
-            return StackElement(StackElement::Boolean,
-                StackElement::BooleanType(isTrueToken));
+            id = _stringToWordDict[s];
         }
-        else if (isNum)
+        else
         {
-            // ohai, it's a number
-            return StackElement(StackElement::Number, numVal);
+            id = (_stringToWordDict[s] = _stringToWordDict.size() + 1);
+            if (contains(_variablesInScope, s))
+            {
+                _variablesInScope.erase(s);
+            }
         }
-        else if (tok.getType() == Token::TokenType::StringLiteral)
+
+        StackElement::placeCode(code, _codeArena.get());
+        if (contains(_deferredWords, s))
         {
-            // ohai, it's a string literal
-            //
-            // escaped quotations are not really supported yet...
-            return StackElement(StackElement::String,
-                tok.getData());
+            _dictionary[id].back() = std::move(code);
+            _deferredWords.erase(s);
         }
-        else if (tok.getType() == Token::TokenType::QuotationOpen)
+        else
         {
-            vector<StackElement> quotation;
-            while (tokenizer.hasNextToken())
+            _dictionary[id].push_back(std::move(code));
+            if (_dictionary[id].size() > 1 && ++_redefinitionsSinceGc >= GC_REDEFINITION_THRESHOLD)
             {
-                Token nextTok = tokenizer.getNextToken();
+                _gcRequested = true;
+            }
+        }
+    }
 
-                if (nextTok.getType() == Token::TokenType::QuotationClose)
-                {
-                    break;
-                }
+    // Walks compiled code, calling visit for every word reference in it, including those
+    // inside nested quotations and closures, in the entries of maps and in the slots of
+    // tuples. Maps and tuples are shared and can hold themselves, so each is walked
+    // once; seen records the ones already walked.
+    typedef unordered_set<const void*> SeenValues;
 
-                quotation.push_back(createStackElementFromToken(tokenizer, nextTok));
-            }
+    template <class Code>
+    static void forEachWordReference(const Code& code, const function<void(const StackElement&)>& visit, SeenValues& seen);
 
-            return StackElement(StackElement::Quotation, quotation);
-        }
-        else if (contains(_stringToWordDict, tok.getData()))
+    static void forEachWordReference(const StackElement& elem, const function<void(const StackElement&)>& visit, SeenValues& seen)
+    {
+        switch (elem.type())
         {
-            if (contains(_variablesInScope, tok.getData()))
+        case StackElement::WordReference:
+            visit(elem);
+            break;
+        case StackElement::Quotation:
+            forEachWordReference(elem.quotationData(), visit, seen);
+            if (nullptr != elem.closure())
+            {
+                forEachWordReference(elem.closure()->first, visit, seen);
+                forEachWordReference(elem.closure()->second, visit, seen);
+            }
+            break;
+        case StackElement::Map:
+            if (seen.insert(elem.mapData()).second)
             {
-                return StackElement(StackElement::ElementType::Variable, tok.getData());
+                const HashMap::Entries& entries = elem.mapData()->entries();
+                for (auto itr = entries.cbegin(); itr != entries.cend(); itr++)
+                {
+                    if ((*itr).live)
+                    {
+                        forEachWordReference((*itr).key, visit, seen);
+                        forEachWordReference((*itr).value, visit, seen);
+                    }
+                }
             }
+            break;
+        case StackElement::Tuple:
+            if (seen.insert(elem.tupleData()).second)
+            {
+                forEachWordReference(elem.tupleData()->slots, visit, seen);
+            }
+            break;
+        default:
+            break;
+        }
+    }
 
-            WORD_ID id = _stringToWordDict[tok.getData()];
-            int currentScopeWordDef = _dictionary[id].size() == 0 ? 0 : _dictionary[id].size() - 1;
-            return StackElement(StackElement::WordReference, tok.getData(), id, currentScopeWordDef);
+    template <class Code>
+    static void forEachWordReference(const Code& code, const function<void(const StackElement&)>& visit, SeenValues& seen)
+    {
+        for (auto itr = code.cbegin(); itr != code.cend(); itr++)
+        {
+            forEachWordReference(*itr, visit, seen);
         }
-        else
+    }
+
+    // Element count and approximate heap footprint of compiled code.
+    static void measureCode(const CodeVector& code, size_t& elements, size_t& bytes)
+    {
+        elements += code.size();
+        bytes += code.capacity() * sizeof(StackElement);
+        for (auto itr = code.cbegin(); itr != code.cend(); itr++)
         {
-            stringstream strBuilder;
-            strBuilder << "'" << tok.getData() << "' (type: " << tok.getType() << ") is not a defined word or valid data type";
-            throw ThrofException("Interpreter", strBuilder.str().c_str(), _filename);
+            switch ((*itr).type())
+            {
+            case StackElement::String:
+                bytes += (*itr).interned() ? 0 : (*itr).stringLength();
+                break;
+            case StackElement::Quotation:
+                measureCode((*itr).quotationData(), elements, bytes);
+                break;
+            default:
+                break;
+            }
         }
     }
 
-    void Interpreter::addWordToDictionary(Tokenizer& tokenizer, const string& s)
+    // Frees superseded definitions that nothing live can call any more. The roots are
+    // the latest definition of every word (which is also where variables keep their
+    // value), the data stack and the quotations waiting in the event loop; anything
+    // reachable from them through word references, map entries or tuple slots stays. A
+    // freed definition keeps its slot in _dictionary, emptied, so the definition indices
+    // held by word references stay valid.
+    void Interpreter::collectGarbage()
     {
-        vector<StackElement> ret;
-        Token tok = tokenizer.getNextToken();
+        _gcRequested = false;
+        _redefinitionsSinceGc = 0;
 
-        while (tok.getType() != Token::DefinitionTerminator)
+        unordered_map<WORD_ID, vector<bool>> marked;
+        vector<const CodeVector*> pending;
+        vector<pair<WORD_ID, int>> order;
+
+        auto mark = [&](const StackElement& ref)
         {
-            ret.push_back(createStackElementFromToken(tokenizer, tok));
+            auto entry = _dictionary.find(ref.wordRefId());
+            int index = ref.wordRefCurrentOffset();
+            if (entry == _dictionary.end() || index < 0 || index >= static_cast<int>((*entry).second.size()))
+            {
+                return;
+            }
 
-            if (tokenizer.hasNextToken())
+            vector<bool>& seen = marked[ref.wordRefId()];
+            seen.resize((*entry).second.size());
+            if (!seen[index])
             {
-                tok = tokenizer.getNextToken();
+                seen[index] = true;
+                pending.push_back(&(*entry).second[index]);
+                order.push_back(make_pair(ref.wordRefId(), index));
             }
-            else
+        };
+
+        for (auto itr = _dictionary.cbegin(); itr != _dictionary.cend(); itr++)
+        {
+            if (!(*itr).second.empty())
             {
-                stringstream errBuilder;
-                errBuilder << "word definition terminator (' ; ') expected at end of word '";
-                errBuilder << s << "'";
-                throw ThrofException("Interpreter", errBuilder.str(), tokenizer.filename());
+                mark(StackElement(StackElement::WordReference, "", (*itr).first, (*itr).second.size() - 1));
             }
         }
 
-        WORD_ID id;
-        if (contains(_stringToWordDict, s))
+        SeenValues seen;
+        forEachWordReference(_stack, mark, seen);
+
+        vector<StackElement*> waiting;
+        _eventLoop.pendingQuotations(waiting);
+        for (auto itr = waiting.cbegin(); itr != waiting.cend(); itr++)
         {
-            id = _stringToWordDict[s];
+            forEachWordReference(**itr, mark, seen);
         }
-        else
+
+        while (!pending.empty())
         {
-            id = (_stringToWordDict[s] = _stringToWordDict.size() + 1);
-            if (contains(_variablesInScope, s))
+            const CodeVector* code = pending.back();
+            pending.pop_back();
+            forEachWordReference(*code, mark, seen);
+        }
+
+        size_t freedDefinitions = 0, freedBytes = 0;
+        for (auto itr = _dictionary.begin(); itr != _dictionary.end(); itr++)
+        {
+            vector<CodeVector>& versions = (*itr).second;
+            const vector<bool>& seen = marked[(*itr).first];
+            for (size_t ii = 0; ii + 1 < versions.size(); ii++)
             {
-                _variablesInScope.erase(s);
+                if (ii < seen.size() && seen[ii])
+                {
+                    continue;
+                }
+
+                if (!versions[ii].empty())
+                {
+                    size_t elements = 0;
+                    measureCode(versions[ii], elements, freedBytes);
+                    freedDefinitions++;
+                }
+                CodeVector().swap(versions[ii]);
             }
         }
 
-        if (contains(_deferredWords, s))
+        // Move what survived into a fresh arena, in the order it was reached: a word's
+        // callees land right after it. The old arena, and everything freed above, goes
+        // away with it.
+        unique_ptr<ArenaResource> compacted(new ArenaResource());
+        for (auto itr = order.cbegin(); itr != order.cend(); itr++)
         {
-            _dictionary[id].back() = ret;
-            _deferredWords.erase(s);
+            StackElement::placeCode(_dictionary[(*itr).first][(*itr).second], compacted.get());
         }
-        else
+        _codeArena.swap(compacted);
+
+        _stats.gcRuns++;
+        _stats.reclaimedDefinitions += freedDefinitions;
+        _stats.reclaimedBytes += freedBytes;
+
+        if (_gcReport)
         {
-            _dictionary[id].push_back(ret);
+            _gcReport = false;
+            cout << "gc: freed " << freedDefinitions << " superseded definitions (" << freedBytes << " bytes)" << endl;
         }
     }
 
@@ -524,7 +2611,12 @@ namespace throf
         case StackElement::String:
         case StackElement::Variable:
         case StackElement::Quotation:
-            _stack.push_back(elem);
+        case StackElement::Array:
+        case StackElement::Double:
+        case StackElement::BigNumber:
+        case StackElement::Map:
+        case StackElement::Tuple:
+            push(elem);
             break;
         case StackElement::WordReference:
             dispatch(elem);
@@ -535,12 +2627,12 @@ namespace throf
         }
     }
 
-    void Interpreter::processDirective(Token& directive, Token& arg)
+    void Interpreter::processDirective(Tokenizer& tokenizer, Token& directive, Token& arg)
     {
         const string& data = arg.getData();
         WORD_ID directiveId = _stringToWordDict[directive.getData()];
 
-        auto addDeferralOrVariable = [data](StringToWORDDictionary& strDict, Dictionary& dict) -> void
+        auto addDeferralOrVariable = [this, data](StringToWORDDictionary& strDict, Dictionary& dict) -> void
         {
             WORD_ID id;
             if (contains(strDict, data))
@@ -551,19 +2643,17 @@ namespace throf
             {
                 id = strDict[data] = strDict.size() + 1;
             }
-            vector<StackElement> newVal;
+            CodeVector newVal;
             newVal.push_back(StackElement());
-            dict[id].push_back(newVal);
+            StackElement::placeCode(newVal, _codeArena.get());
+            dict[id].push_back(std::move(newVal));
+            _constants.erase(data);
         };
 
         switch(directiveId)
         {
         case PRIM_INCLUDE:
-            {
-                InputReader reader(data);
-                Tokenizer tokenizer = Tokenizer::tokenize(reader);
-                loadFile(tokenizer);
-            }
+            loadFile(data);
             break;
         case PRIM_DEFER:
             addDeferralOrVariable(_stringToWordDict, _dictionary);
@@ -573,6 +2663,12 @@ namespace throf
             addDeferralOrVariable(_stringToWordDict, _dictionary);
             _variablesInScope.insert(data);
             break;
+        case PRIM_TUPLE:
+            declareTuple(tokenizer, data);
+            break;
+        case PRIM_CONSTANT:
+            declareConstant(tokenizer, data);
+            break;
         default:
             stringstream strBuilder;
             strBuilder << "ERROR: '" << directive.getData() << "' is not a defined word or valid data type";
@@ -580,10 +2676,111 @@ namespace throf
         }
     }
 
+    // :tuple name slot... ; declares a record type with a fixed set of slots, and the words
+    // <name>, name?, and slot>> and >>slot for every slot. Each of these is compiled to a
+    // single tuple primitive bound to the class and slot offset, which word references
+    // to it are then compiled to directly; see createWordReference.
+    void Interpreter::declareTuple(Tokenizer& tokenizer, const string& name)
+    {
+        TupleClass tupleClass;
+        tupleClass.name = name;
+        for (;;)
+        {
+            if (!tokenizer.hasNextToken())
+            {
+                stringstream errBuilder;
+                errBuilder << "definition terminator (' ; ') expected at end of tuple '" << name << "'";
+                throw ThrofException("Interpreter", errBuilder.str(), tokenizer.filename());
+            }
+
+            Token tok = tokenizer.getNextToken();
+            if (tok.getType() == Token::DefinitionTerminator)
+            {
+                break;
+            }
+
+            const vector<string>& slots = tupleClass.slots;
+            if (tok.getType() != Token::WordOrData || std::find(slots.cbegin(), slots.cend(), tok.getData()) != slots.cend())
+            {
+                stringstream errBuilder;
+                errBuilder << "'" << tok.getData() << "' is not a valid slot name for tuple '" << name << "'";
+                throw ThrofException("Interpreter", errBuilder.str(), tokenizer.filename());
+            }
+            tupleClass.slots.push_back(tok.getData());
+        }
+
+        size_t classId = _tupleClasses.size();
+        _tupleClasses.push_back(tupleClass);
+
+        auto define = [this, classId](const string& word, WORD_ID primitive, int slot)
+        {
+            CodeVector code;
+            code.push_back(StackElement::makeBoundPrimitive(word, primitive, classId, slot));
+            defineWord(word, std::move(code));
+        };
+
+        define("<" + name + ">", PRIM_NEW_TUPLE, -1);
+        define(name + "?", PRIM_IS_TUPLE, -1);
+        for (size_t ii = 0; ii < tupleClass.slots.size(); ii++)
+        {
+            define(tupleClass.slots[ii] + ">>", PRIM_SLOT_GET, static_cast<int>(ii));
+            define(">>" + tupleClass.slots[ii], PRIM_SLOT_SET, static_cast<int>(ii));
+        }
+    }
+
+    // :constant name value binds name to a literal, or to the value of another constant,
+    // for good. Uses of name are compiled to a copy of the value rather than a call, so
+    // reading a constant costs what a literal does, and arithmetic on it in a definition
+    // is folded; see appendFolded.
+    void Interpreter::declareConstant(Tokenizer& tokenizer, const string& name)
+    {
+        if (!tokenizer.hasNextToken())
+        {
+            stringstream errBuilder;
+            errBuilder << "value expected after ':constant " << name << "'";
+            throw ThrofException("Interpreter", errBuilder.str(), tokenizer.filename());
+        }
+
+        Token tok = tokenizer.getNextToken();
+        StackElement value = createStackElementFromToken(tokenizer, tok);
+        if (value.type() == StackElement::WordReference || value.type() == StackElement::Variable || value.type() == StackElement::Nil)
+        {
+            stringstream errBuilder;
+            errBuilder << "'" << tok.getData() << "' is not a valid value for constant '" << name << "'";
+            throw ThrofException("Interpreter", errBuilder.str(), tokenizer.filename());
+        }
+
+        CodeVector code;
+        code.push_back(std::move(value));
+        defineWord(name, std::move(code));
+        _variablesInScope.erase(name);
+        _constants.insert(name);
+    }
+
+    void Interpreter::loadFile(const string& filename)
+    {
+        InputReader reader(filename);
+        Tokenizer tokenizer = [&]()
+        {
+            RuntimeStats::Timer timer(_stats.files[filename].tokenizeNs);
+            return Tokenizer::tokenize(reader);
+        }();
+        try
+        {
+            loadFile(tokenizer);
+        }
+        catch (const QuotaExceeded& e)
+        {
+            rethrowWithFilename(e);
+        }
+    }
+
     // build the dictionary and script context
     void Interpreter::loadFile(Tokenizer& tokenizer)
     {
+        DefaultResourceScope scope(_scratchResource);
         _filename = tokenizer.filename();
+        RuntimeStats::FileTimes& times = _stats.files[tokenizer.filename()];
 
         while (tokenizer.hasNextToken())
         {
@@ -591,21 +2788,34 @@ namespace throf
             switch (tok.getType())
             {
             case Token::TokenType::WordDefinition:
-                addWordToDictionary(tokenizer, tok.getData());
+                {
+                    RuntimeStats::Timer timer(times.compileNs);
+                    addWordToDictionary(tokenizer, tok.getData(), false);
+                }
+                break;
+            case Token::TokenType::LocalsDefinition:
+                {
+                    RuntimeStats::Timer timer(times.compileNs);
+                    addWordToDictionary(tokenizer, tok.getData(), true);
+                }
                 break;
             case Token::TokenType::WordOrData:
             case Token::TokenType::StringLiteral:
-                processToken(tokenizer, tok);
+                {
+                    RuntimeStats::Timer timer(times.executeNs);
+                    processToken(tokenizer, tok);
+                }
                 break;
             case Token::TokenType::Directive:
                 {
                     Token directiveArg = tokenizer.getNextToken();
-                    processDirective(tok, directiveArg);
+                    processDirective(tokenizer, tok, directiveArg);
                 }
                 break;
             case Token::TokenType::QuotationOpen:
                 {
-                    vector<StackElement> quotation;
+                    RuntimeStats::Timer timer(times.compileNs);
+                    CodeVector quotation((ResourceAllocator<StackElement>(&_compileArena)));
                     while (tokenizer.hasNextToken())
                     {
                         tok = tokenizer.getNextToken();
@@ -623,7 +2833,10 @@ namespace throf
                         throw ThrofException("Interpreter", "unexpected end of quotation without closing marker ']'", _filename);
                     }
 
-                    _stack.push_back(StackElement(StackElement::Quotation, quotation));
+                    // pushed as a copy: the body is in the compile arena, which is
+                    // rewound after this token
+                    const StackElement compiled(StackElement::Quotation, std::move(quotation));
+                    push(compiled);
                 }
                 break;
             case Token::TokenType::QuotationClose:
@@ -634,6 +2847,17 @@ namespace throf
                 strBuilder << tok.getType() << ")";
                 throw ThrofException("Interpreter", strBuilder.str().c_str(), "");
             }
+
+            // between top level tokens no definition is executing and nothing the
+            // compiler built is still in use
+            if (_stats.returnStackDepth == 0)
+            {
+                _compileArena.rewind();
+                if (_gcRequested)
+                {
+                    collectGarbage();
+                }
+            }
         }
     }
 
@@ -656,6 +2880,19 @@ namespace throf
         case StackElement::Quotation:
             prettyFormatQuotation(elem, strBuilder);
             break;
+        case StackElement::Double:
+        case StackElement::BigNumber:
+            strBuilder << numeric::format(elem) << " ";
+            break;
+        case StackElement::Array:
+            prettyFormatArray(elem, strBuilder);
+            break;
+        case StackElement::Map:
+            prettyFormatMap(elem, strBuilder);
+            break;
+        case StackElement::Tuple:
+            prettyFormatTuple(elem, strBuilder);
+            break;
         case StackElement::WordReference:
             strBuilder << elem.wordName() << " ";
             break;
@@ -674,7 +2911,8 @@ namespace throf
 
     void Interpreter::prettyFormatQuotation(const StackElement& elem, stringstream& strBuilder)
     {
-        vector<StackElement> elements = elem.quotationData();
+        CodeVector flattened;
+        const CodeVector& elements = (nullptr != elem.closure()) ? (flattened = elem.flattenQuotation()) : elem.quotationData();
         strBuilder << "[ ";
         for (size_t ii = 0; ii < elements.size(); ii++)
         {
@@ -683,6 +2921,72 @@ namespace throf
         strBuilder << "] ";
     }
 
+    // { 1 2 3 }, long arrays cut short with the count of what was left out
+    void Interpreter::prettyFormatArray(const StackElement& elem, stringstream& strBuilder)
+    {
+        static const size_t MAX_SHOWN = 16;
+
+        const NumericArray& data = *elem.arrayData();
+        size_t shown = min(data.size(), MAX_SHOWN);
+        strBuilder << "{ ";
+        for (size_t ii = 0; ii < shown; ii++)
+        {
+            if (data.kind == NumericArray::Int64)
+            {
+                strBuilder << data.ints[ii] << " ";
+            }
+            else
+            {
+                strBuilder << numeric::format(StackElement::makeDouble(data.doubles[ii])) << " ";
+            }
+        }
+        if (shown < data.size())
+        {
+            strBuilder << "... (" << data.size() - shown << " more) ";
+        }
+        strBuilder << "} ";
+    }
+
+    void Interpreter::prettyFormatMap(const StackElement& elem, stringstream& strBuilder)
+    {
+        static const size_t MAX_SHOWN = 16;
+
+        const HashMap& map = *elem.mapData();
+        size_t shown = 0;
+        strBuilder << "H{ ";
+        for (auto itr = map.entries().cbegin(); itr != map.entries().cend() && shown < MAX_SHOWN; itr++)
+        {
+            if ((*itr).live)
+            {
+                strBuilder << "{ ";
+                prettyFormatStackElement((*itr).key, strBuilder);
+                prettyFormatStackElement((*itr).value, strBuilder);
+                strBuilder << "} ";
+                shown++;
+            }
+        }
+        if (shown < map.size())
+        {
+            strBuilder << "... (" << map.size() - shown << " more) ";
+        }
+        strBuilder << "} ";
+    }
+
+    // T{ point { x 1 } { y 2 } }
+    void Interpreter::prettyFormatTuple(const StackElement& elem, stringstream& strBuilder)
+    {
+        const TupleValue& tuple = *elem.tupleData();
+        const TupleClass& tupleClass = _tupleClasses[tuple.classId];
+        strBuilder << "T{ " << tupleClass.name << " ";
+        for (size_t ii = 0; ii < tuple.slots.size(); ii++)
+        {
+            strBuilder << "{ " << tupleClass.slots[ii] << " ";
+            prettyFormatStackElement(tuple.slots[ii], strBuilder);
+            strBuilder << "} ";
+        }
+        strBuilder << "} ";
+    }
+
     string Interpreter::stackToString()
     {
         stringstream strBuilder;
@@ -702,6 +3006,71 @@ namespace throf
         return strBuilder.str();
     }
 
+    string Interpreter::statsToString()
+    {
+        size_t definitions = 0, superseded = 0, elements = 0, payloadBytes = 0;
+        for (auto itr = _dictionary.cbegin(); itr != _dictionary.cend(); itr++)
+        {
+            // definitions freed by the gc are left behind as empty slots
+            const vector<CodeVector>& versions = (*itr).second;
+            for (size_t ii = 0; ii < versions.size(); ii++)
+            {
+                bool isLatest = (ii + 1 == versions.size());
+                if (isLatest || !versions[ii].empty())
+                {
+                    definitions++;
+                    superseded += isLatest ? 0 : 1;
+                    measureCode(versions[ii], elements, payloadBytes);
+                }
+            }
+        }
+
+        const StackElement::AllocationStats& allocations = StackElement::allocationStats();
+
+        stringstream strBuilder;
+        strBuilder << "Statistics : " << endl << endl;
+        strBuilder << "\tvalues pushed / popped    : " << _stats.pushes << " / " << _stats.pops << endl;
+        strBuilder << "\tpeak data stack depth     : " << _stats.peakStackDepth << endl;
+        strBuilder << "\tpeak return stack depth   : " << _stats.peakReturnStackDepth << endl;
+        strBuilder << "\tstring allocations        : " << allocations.stringAllocations;
+        strBuilder << " (" << allocations.stringBytes << " bytes)" << endl;
+        strBuilder << "\tquotation allocations     : " << allocations.quotationAllocations;
+        strBuilder << " (" << allocations.quotationBytes << " bytes)" << endl;
+        strBuilder << "\tinterned strings          : " << SymbolTable::size() << " (" << SymbolTable::bytes() << " bytes)" << endl;
+        strBuilder << "\tdictionary words          : " << _stringToWordDict.size() - STR_TO_PRIM_WORD_MAP.size();
+        strBuilder << " compiled, " << STR_TO_PRIM_WORD_MAP.size() << " primitive" << endl;
+        strBuilder << "\tdictionary definitions    : " << definitions << " (" << superseded << " superseded)" << endl;
+        strBuilder << "\tdictionary elements       : " << elements << " (" << payloadBytes << " bytes)" << endl;
+        strBuilder << "\tgc                        : " << _stats.gcRuns << " runs, " << _stats.reclaimedDefinitions;
+        strBuilder << " definitions freed (" << _stats.reclaimedBytes << " bytes)" << endl;
+        strBuilder << "\tcode arena                : " << _codeArena->bytesAllocated() << " bytes used, ";
+        strBuilder << _codeArena->bytesReserved() << " reserved in " << _codeArena->chunkCount() << " chunks" << endl;
+        strBuilder << "\tarray kernels             : " << simd::levelName(simd::level()) << endl;
+        strBuilder << endl;
+
+        strBuilder << "\t" << setw(14) << "tokenize ms" << setw(14) << "compile ms" << setw(14) << "execute ms" << "  file" << endl;
+        strBuilder << fixed << setprecision(3);
+        for (auto itr = _stats.files.cbegin(); itr != _stats.files.cend(); itr++)
+        {
+            const RuntimeStats::FileTimes& times = (*itr).second;
+            strBuilder << "\t" << setw(14) << times.tokenizeNs / 1e6 << setw(14) << times.compileNs / 1e6;
+            strBuilder << setw(14) << times.executeNs / 1e6 << "  " << (*itr).first << endl;
+        }
+        strBuilder << endl;
+
+        return strBuilder.str();
+    }
+
+    Profiler::WordNames Interpreter::wordNames() const
+    {
+        Profiler::WordNames names;
+        for (auto itr = _stringToWordDict.cbegin(); itr != _stringToWordDict.cend(); itr++)
+        {
+            names[(*itr).second] = (*itr).first;
+        }
+        return names;
+    }
+
     string Interpreter::loadedWordsToString()
     {
         stringstream strBuilder;
@@ -713,7 +3082,7 @@ namespace throf
         {
             if (_dictionary[(*itr).second].size() > 0)
             {
-                vector<StackElement>& stackElems = _dictionary[(*itr).second].back();
+                CodeVector& stackElems = _dictionary[(*itr).second].back();
                 strBuilder << "\t" << (*itr).first << " : ";
 
                 for (auto jtr = stackElems.cbegin(); jtr != stackElems.cend(); jtr++)
@@ -10,21 +10,68 @@ namespace throf
 
         void repl();
         void loadFile(Tokenizer& tokenizer);
+        void loadFile(const std::string& filename);
+        std::string stackToString();
+        std::string statsToString();
+        void processRecords(RecordReader& records, const std::string& recordWord, const std::string& finishWord);
+        void setMemoryResource(MemoryResource* resource);
+        void setLimits(const Quota::Limits& limits);
+        void evaluate(Tokenizer& tokenizer, MemoryResource* scratch);
+        void startProfiling();
+        void reportProfile();
+        void startSampling(int frequency);
+        void reportSamples();
+        void startTracing(const std::string& filename);
+        void stopTracing();
 
     // helper funcs
     private:
         void initialize();
-        void dispatch(const StackElement elem);
-        void processDirective(Token& directive, Token& arg);
+        void dispatch(const StackElement& elem);
+        void push(const StackElement& elem);
+        void push(StackElement&& elem);
+        StackElement pop();
+        void throwStackOverflow(const StackElement& elem);
+        void rethrowWithFilename(const QuotaExceeded& e);
+        void dispatchControlWord(WORD_ID id);
+        void dispatchCombinatorWord(WORD_ID id);
+        void dispatchStackWord(WORD_ID id);
+        void dispatchVariableWord(WORD_ID id);
+        void dispatchNumericWord(WORD_ID id);
+        void dispatchLogicWord(WORD_ID id);
+        void dispatchReportingWord(WORD_ID id);
+        void pushLocal(const StackElement& local);
+        void captureLocals(const StackElement& capture);
+        void dispatchEventLoopWord(WORD_ID id);
+        void dispatchArrayWord(WORD_ID id);
+        void dispatchStringWord(WORD_ID id);
+        void dispatchMapWord(WORD_ID id);
+        void dispatchTupleWord(const StackElement& word);
+        void callQuotation(const StackElement& quotation);
+        void callWithLocals(const CodeVector& def);
+        StackElement popQuotation(const char* word);
+        void benchmark(const StackElement& quotation, long iterations);
+        void runEventLoop();
+        void processDirective(Tokenizer& tokenizer, Token& directive, Token& arg);
+        void declareTuple(Tokenizer& tokenizer, const std::string& name);
+        void declareConstant(Tokenizer& tokenizer, const std::string& name);
         void processToken(Tokenizer& tokenizer, const Token& tok);
         StackElement createStackElementFromToken( Tokenizer& tokenizer, const Token& tok);
-        void addWordToDictionary(Tokenizer& tokenizer, const std::string& s);
-        std::string stackToString();
+        StackElement createWordReference(const std::string& name);
+        void addWordToDictionary(Tokenizer& tokenizer, const std::string& s, bool hasLocals);
+        void defineWord(const std::string& s, CodeVector code);
+        void appendFolded(CodeVector& code, StackElement elem);
+        void collectGarbage();
+        void rehomeRuntimeValues();
         std::string loadedWordsToString();
+        Profiler::WordNames wordNames() const;
 
         // pretty printers
         void prettyFormatStackElement(const StackElement& elem, stringstream& strBuilder);
         void prettyFormatQuotation(const StackElement& elem, stringstream& strBuilder);
+        void prettyFormatArray(const StackElement& elem, stringstream& strBuilder);
+        void prettyFormatMap(const StackElement& elem, stringstream& strBuilder);
+        void prettyFormatTuple(const StackElement& elem, stringstream& strBuilder);
 
         // convenience throwers
         void throwIfTypeUnexpected(const StackElement& element,
@@ -32,18 +79,87 @@ namespace throf
 
         void throwIfVariableNotDefined(const StackElement& element, const string msg) const;
 
+        // Binds the inputs of a word defined with :: to a new frame, for as long as the
+        // word runs.
+        class FrameScope
+        {
+        public:
+            FrameScope(Interpreter& interpreter, const StackElement& bindLocals);
+            ~FrameScope();
+
+        private:
+            Interpreter& _interpreter;
+        };
+
         // block assignment
         Interpreter& operator=(Interpreter& right) { return right; }
 
     // member vars
     private:
         typedef unordered_map<string, WORD_ID> StringToWORDDictionary;
-        typedef unordered_map<WORD_ID, std::vector<std::vector<StackElement>>> Dictionary;
+        typedef unordered_map<WORD_ID, std::vector<CodeVector>> Dictionary;
+
+        // A record type declared with :tuple. A TupleValue refers to its class by index
+        // into _tupleClasses; declaring a tuple again adds a new class rather than
+        // changing the one existing values were made with.
+        struct TupleClass
+        {
+            std::string name;
+            std::vector<std::string> slots;
+        };
+
+        // Compiled definitions live in _codeArena, which the gc replaces with a compacted
+        // copy; _compileArena holds the compiler's intermediate code and is rewound after
+        // every top level token. Both are declared before anything that holds code so
+        // they are destroyed last, after the memory limit values may be allocated through.
+        std::unique_ptr<LimitedResource> _memoryLimit;
+        std::unique_ptr<ArenaResource> _codeArena;
+        ArenaResource _compileArena;
         Dictionary _dictionary;
         StringToWORDDictionary _stringToWordDict;
         unordered_set<string> _variablesInScope;
         unordered_set<string> _deferredWords;
-        std::vector<StackElement> _stack;
+        unordered_set<string> _constants;
+        std::vector<TupleClass> _tupleClasses;
+
+        // The locals of the :: words running, innermost last. A local is read through
+        // the innermost frame of the definition it was compiled in, found by the number
+        // that definition was given. Quotations take the values of their locals along
+        // when they are pushed, so they still see the frame they were made in when they
+        // are passed down to another word or a recursive call of their own.
+        struct Frame
+        {
+            size_t definition;
+            size_t base;
+        };
+
+        const Frame& frameOf(const StackElement& local);
+        CodeVector captureLocals(const CodeVector& code, const Frame& frame);
+
+        std::vector<Frame> _frames;
+        CodeVector _locals;
+
+        // the inputs of the :: definition being compiled, if any
+        std::vector<std::string> _compilingLocals;
+        size_t _compilingDefinition;
+        size_t _localsDefinitions;
+
+        CodeVector _stack;
+        EventLoop _eventLoop;
+        Profiler _profiler;
+        Sampler _sampler;
+        Tracer _tracer;
+        RuntimeStats _stats;
+        bool _gcRequested;
+        bool _gcReport;
+        size_t _redefinitionsSinceGc;
+
+        // Runtime values (the stack, variables, strings and quotations built while
+        // running) come from _scratchResource. Outside evaluate() that is the same as
+        // _memoryResource, which holds everything that has to outlive a request.
+        MemoryResource* _memoryResource;
+        MemoryResource* _scratchResource;
+        Quota _quota;
         std::string _filename;
     };
 }
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include "stdafx.h"
+
+namespace throf
+{
+    using namespace std;
+
+    const size_t MemoryResource::MAX_ALIGNMENT;
+    const size_t ArenaResource::DEFAULT_CHUNK_SIZE;
+
+    class HeapResource : public MemoryResource
+    {
+    protected:
+        virtual void* doAllocate(size_t bytes, size_t)
+        {
+            return ::operator new(bytes);
+        }
+
+        virtual void doDeallocate(void* p, size_t, size_t)
+        {
+            ::operator delete(p);
+        }
+    };
+
+    MemoryResource* heapResource()
+    {
+        static HeapResource s_heap;
+        return &s_heap;
+    }
+
+    static MemoryResource* s_defaultResource = nullptr;
+
+    MemoryResource* defaultResource()
+    {
+        return nullptr != s_defaultResource ? s_defaultResource : heapResource();
+    }
+
+    MemoryResource* setDefaultResource(MemoryResource* resource)
+    {
+        MemoryResource* previous = defaultResource();
+        s_defaultResource = resource;
+        return previous;
+    }
+
+    ArenaResource::ArenaResource(size_t chunkSize) :
+        _currentChunk(0),
+        _cursor(nullptr),
+        _end(nullptr),
+        _chunkSize(chunkSize),
+        _bytesAllocated(0),
+        _bytesReserved(0)
+    {
+    }
+
+    ArenaResource::~ArenaResource()
+    {
+        for (auto itr = _chunks.begin(); itr != _chunks.end(); itr++)
+        {
+            delete[] (*itr).memory;
+        }
+    }
+
+    void ArenaResource::rewind()
+    {
+        _currentChunk = 0;
+        _cursor = _chunks.empty() ? nullptr : _chunks[0].memory;
+        _end = _chunks.empty() ? nullptr : _chunks[0].memory + _chunks[0].size;
+        _bytesAllocated = 0;
+    }
+
+    // moves on to the next chunk that fits, allocating one if there is none
+    void ArenaResource::nextChunk(size_t minimumSize)
+    {
+        size_t next = _chunks.empty() ? 0 : _currentChunk + 1;
+        while (next < _chunks.size() && _chunks[next].size < minimumSize)
+        {
+            next++;
+        }
+
+        if (next == _chunks.size())
+        {
+            Chunk chunk;
+            chunk.size = max(_chunkSize, minimumSize);
+            chunk.memory = new char[chunk.size];
+            _chunks.push_back(chunk);
+            _bytesReserved += chunk.size;
+        }
+
+        _currentChunk = next;
+        _cursor = _chunks[next].memory;
+        _end = _cursor + _chunks[next].size;
+    }
+
+    void* ArenaResource::doAllocate(size_t bytes, size_t alignment)
+    {
+        size_t padding = (alignment - reinterpret_cast<uintptr_t>(_cursor) % alignment) % alignment;
+        if (nullptr == _cursor || static_cast<size_t>(_end - _cursor) < padding + bytes)
+        {
+            nextChunk(bytes + alignment);
+            padding = (alignment - reinterpret_cast<uintptr_t>(_cursor) % alignment) % alignment;
+        }
+
+        char* p = _cursor + padding;
+        _cursor = p + bytes;
+        _bytesAllocated += bytes;
+        return p;
+    }
+
+    void ArenaResource::doDeallocate(void*, size_t, size_t)
+    {
+    }
+
+    LimitedResource::LimitedResource(size_t limit, MemoryResource* upstream) :
+        _limit(limit),
+        _upstream(upstream),
+        _bytesInUse(0),
+        _peakBytesInUse(0)
+    {
+    }
+
+    void* LimitedResource::doAllocate(size_t bytes, size_t alignment)
+    {
+        if (bytes > _limit - _bytesInUse)
+        {
+            stringstream strBuilder;
+            strBuilder << "memory limit of " << _limit << " bytes exceeded (" << _bytesInUse;
+            strBuilder << " in use, " << bytes << " requested)";
+            throw QuotaExceeded("memory", strBuilder.str());
+        }
+
+        void* p = _upstream->allocate(bytes, alignment);
+        _bytesInUse += bytes;
+        _peakBytesInUse = max(_peakBytesInUse, _bytesInUse);
+        return p;
+    }
+
+    void LimitedResource::doDeallocate(void* p, size_t bytes, size_t alignment)
+    {
+        _upstream->deallocate(p, bytes, alignment);
+        if (_upstream->releasesOnDeallocate())
+        {
+            _bytesInUse -= bytes;
+        }
+    }
+}
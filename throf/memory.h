@@ -0,0 +1,184 @@
+#pragma once
+
+#include <stdint.h>
+#include <type_traits>
+
+namespace throf
+{
+    // Where container memory comes from. A C++11 stand-in for std::pmr::memory_resource:
+    // containers hold a ResourceAllocator that forwards to one of these.
+    class MemoryResource
+    {
+    public:
+        static const size_t MAX_ALIGNMENT = 16;
+
+        virtual ~MemoryResource() { }
+
+        void* allocate(size_t bytes, size_t alignment = MAX_ALIGNMENT)
+        {
+            return doAllocate(bytes, alignment);
+        }
+
+        void deallocate(void* p, size_t bytes, size_t alignment = MAX_ALIGNMENT)
+        {
+            doDeallocate(p, bytes, alignment);
+        }
+
+        // false if deallocated memory is not given back until some later point, so
+        // that whoever counts what is in use must not count it as freed
+        virtual bool releasesOnDeallocate() const { return true; }
+
+    protected:
+        virtual void* doAllocate(size_t bytes, size_t alignment) = 0;
+        virtual void doDeallocate(void* p, size_t bytes, size_t alignment) = 0;
+    };
+
+    // operator new / operator delete
+    MemoryResource* heapResource();
+
+    // What default constructed ResourceAllocators allocate from, the heap unless set.
+    // Process wide, like std::pmr::set_default_resource; setDefaultResource returns the
+    // previous one and nullptr puts the heap back.
+    MemoryResource* defaultResource();
+    MemoryResource* setDefaultResource(MemoryResource* resource);
+
+    // Installs a default resource for the lifetime of the scope.
+    class DefaultResourceScope
+    {
+        MemoryResource* _previous;
+
+        // block assignment
+        DefaultResourceScope& operator=(DefaultResourceScope& right) { return right; }
+
+    public:
+        explicit DefaultResourceScope(MemoryResource* resource) : _previous(setDefaultResource(resource)) { }
+        ~DefaultResourceScope() { setDefaultResource(_previous); }
+    };
+
+    // Bump-pointer arena. Allocation carves the next piece out of the current chunk;
+    // deallocation does nothing, the memory comes back when the arena is rewound or
+    // destroyed.
+    class ArenaResource : public MemoryResource
+    {
+    public:
+        static const size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+        explicit ArenaResource(size_t chunkSize = DEFAULT_CHUNK_SIZE);
+        ~ArenaResource();
+
+        // makes all memory available again, keeping the chunks
+        void rewind();
+
+        size_t bytesAllocated() const { return _bytesAllocated; }
+        size_t bytesReserved() const { return _bytesReserved; }
+        size_t chunkCount() const { return _chunks.size(); }
+
+        virtual bool releasesOnDeallocate() const { return false; }
+
+    protected:
+        virtual void* doAllocate(size_t bytes, size_t alignment);
+        virtual void doDeallocate(void* p, size_t bytes, size_t alignment);
+
+    private:
+        struct Chunk
+        {
+            char* memory;
+            size_t size;
+        };
+
+        void nextChunk(size_t minimumSize);
+
+        // block copy and assignment
+        ArenaResource(const ArenaResource&);
+        ArenaResource& operator=(const ArenaResource&);
+
+        std::vector<Chunk> _chunks;
+        size_t _currentChunk;
+        char* _cursor;
+        char* _end;
+        size_t _chunkSize;
+        size_t _bytesAllocated;
+        size_t _bytesReserved;
+    };
+
+    // Passes allocations on to another resource until a byte limit is reached, then
+    // throws QuotaExceeded instead. Frees are only credited back when the upstream
+    // resource really releases them; over an arena the limit caps what was allocated.
+    class LimitedResource : public MemoryResource
+    {
+    public:
+        explicit LimitedResource(size_t limit, MemoryResource* upstream = heapResource());
+
+        size_t limit() const { return _limit; }
+        size_t bytesInUse() const { return _bytesInUse; }
+        size_t peakBytesInUse() const { return _peakBytesInUse; }
+
+    protected:
+        virtual void* doAllocate(size_t bytes, size_t alignment);
+        virtual void doDeallocate(void* p, size_t bytes, size_t alignment);
+
+    private:
+        // block copy and assignment
+        LimitedResource(const LimitedResource&);
+        LimitedResource& operator=(const LimitedResource&);
+
+        size_t _limit;
+        MemoryResource* _upstream;
+        size_t _bytesInUse;
+        size_t _peakBytesInUse;
+    };
+
+    // Allocator bound to a MemoryResource, the default resource unless told otherwise.
+    // Like std::pmr::polymorphic_allocator, a copy of a container does not inherit the
+    // resource but goes to the default one: copies made at runtime from code in an arena
+    // end up wherever runtime values are being allocated. Moves and swaps take the
+    // resource along with the memory.
+    template <class T>
+    class ResourceAllocator
+    {
+    public:
+        typedef T value_type;
+        typedef std::false_type propagate_on_container_copy_assignment;
+        typedef std::true_type propagate_on_container_move_assignment;
+        typedef std::true_type propagate_on_container_swap;
+
+        ResourceAllocator() : _resource(defaultResource()) { }
+
+        ResourceAllocator(MemoryResource* resource) : _resource(resource) { }
+
+        template <class U>
+        ResourceAllocator(const ResourceAllocator<U>& other) : _resource(other.resource()) { }
+
+        T* allocate(size_t count)
+        {
+            return static_cast<T*>(_resource->allocate(count * sizeof(T), std::alignment_of<T>::value));
+        }
+
+        void deallocate(T* p, size_t count)
+        {
+            _resource->deallocate(p, count * sizeof(T), std::alignment_of<T>::value);
+        }
+
+        ResourceAllocator select_on_container_copy_construction() const
+        {
+            return ResourceAllocator();
+        }
+
+        MemoryResource* resource() const { return _resource; }
+
+    private:
+        MemoryResource* _resource;
+    };
+
+    template <class T, class U>
+    bool operator==(const ResourceAllocator<T>& left, const ResourceAllocator<U>& right)
+    {
+        return left.resource() == right.resource();
+    }
+
+    template <class T, class U>
+    bool operator!=(const ResourceAllocator<T>& left, const ResourceAllocator<U>& right)
+    {
+        return left.resource() != right.resource();
+    }
+}
@@ -0,0 +1,229 @@
+#include "stdafx.h"
+#include <iomanip>
+
+namespace throf
+{
+    namespace numeric
+    {
+        static BigInteger toBigInteger(const StackElement& number)
+        {
+            const BigInteger* big = number.bigIntegerData();
+            return (nullptr != big) ? *big : BigInteger(number.numberData());
+        }
+
+        // a Number when it fits, so the next operation is back on the fast path
+        static StackElement narrow(const BigInteger& value)
+        {
+            if (value.fitsInt64())
+            {
+                return StackElement(StackElement::Number, value.toInt64());
+            }
+            return StackElement::makeBigInteger(value);
+        }
+
+        double toDouble(const StackElement& number)
+        {
+            switch (number.type())
+            {
+            case StackElement::Double:
+                return number.doubleData();
+            case StackElement::BigNumber:
+                return number.bigIntegerData()->toDouble();
+            default:
+                return static_cast<double>(number.numberData());
+            }
+        }
+
+        StackElement arithmetic(WORD_ID operation, const StackElement& left, const StackElement& right, const std::string& filename)
+        {
+            if (left.type() == StackElement::Double || right.type() == StackElement::Double)
+            {
+                double l = toDouble(left), r = toDouble(right);
+                switch (operation)
+                {
+                case PRIM_ADD:
+                    return StackElement::makeDouble(l + r);
+                case PRIM_SUB:
+                    return StackElement::makeDouble(l - r);
+                case PRIM_MUL:
+                    return StackElement::makeDouble(l * r);
+                case PRIM_DIV:
+                    return StackElement::makeDouble(l / r);
+                default:
+                    return StackElement::makeDouble(fmod(l, r));
+                }
+            }
+
+            if (left.type() == StackElement::Number && right.type() == StackElement::Number)
+            {
+                int64_t result;
+                if (int64Arithmetic(operation, left.numberData(), right.numberData(), result))
+                {
+                    return StackElement(StackElement::Number, result);
+                }
+            }
+
+            BigInteger l = toBigInteger(left), r = toBigInteger(right);
+            switch (operation)
+            {
+            case PRIM_ADD:
+                return narrow(BigInteger::add(l, r));
+            case PRIM_SUB:
+                return narrow(BigInteger::subtract(l, r));
+            case PRIM_MUL:
+                return narrow(BigInteger::multiply(l, r));
+            }
+
+            if (r.isZero())
+            {
+                throw ThrofException("Interpreter", (PRIM_DIV == operation) ? "division by zero" : "modulo by zero", filename);
+            }
+
+            BigInteger quotient, remainder;
+            BigInteger::divide(l, r, quotient, remainder);
+            return narrow(PRIM_DIV == operation ? quotient : remainder);
+        }
+
+        bool less(const StackElement& left, const StackElement& right)
+        {
+            if (left.type() == StackElement::Number && right.type() == StackElement::Number)
+            {
+                return left.numberData() < right.numberData();
+            }
+            if (left.type() == StackElement::Double || right.type() == StackElement::Double)
+            {
+                return toDouble(left) < toDouble(right);
+            }
+            return BigInteger::compare(toBigInteger(left), toBigInteger(right)) < 0;
+        }
+
+        bool equal(const StackElement& left, const StackElement& right)
+        {
+            if (left.type() == StackElement::Number && right.type() == StackElement::Number)
+            {
+                return left.numberData() == right.numberData();
+            }
+            if (left.type() == StackElement::Double || right.type() == StackElement::Double)
+            {
+                return toDouble(left) == toDouble(right);
+            }
+            return BigInteger::compare(toBigInteger(left), toBigInteger(right)) == 0;
+        }
+
+        // [+-]digits[.digits][(e|E)[+-]digits], with a fraction or an exponent
+        static bool isDoubleLiteral(const std::string& token)
+        {
+            size_t ii = (!token.empty() && (token[0] == '-' || token[0] == '+')) ? 1 : 0;
+            auto digits = [&token, &ii]()
+            {
+                size_t start = ii;
+                while (ii < token.size() && std::isdigit(static_cast<unsigned char>(token[ii])))
+                {
+                    ii++;
+                }
+                return ii > start;
+            };
+
+            if (!digits())
+            {
+                return false;
+            }
+
+            bool fraction = false, exponent = false;
+            if (ii < token.size() && token[ii] == '.')
+            {
+                ii++;
+                fraction = digits();
+                if (!fraction)
+                {
+                    return false;
+                }
+            }
+            if (ii < token.size() && (token[ii] == 'e' || token[ii] == 'E'))
+            {
+                ii++;
+                if (ii < token.size() && (token[ii] == '-' || token[ii] == '+'))
+                {
+                    ii++;
+                }
+                exponent = digits();
+                if (!exponent)
+                {
+                    return false;
+                }
+            }
+            return ii == token.size() && (fraction || exponent);
+        }
+
+        bool parse(const std::string& token, StackElement& result)
+        {
+            // most tokens are words; rule them out before anything else
+            size_t digit = (!token.empty() && (token[0] == '-' || token[0] == '+')) ? 1 : 0;
+            if (digit >= token.size() || !std::isdigit(static_cast<unsigned char>(token[digit])))
+            {
+                return false;
+            }
+
+            errno = 0;
+            char* end = nullptr;
+            long long value = strtoll(token.c_str(), &end, 10);
+            if (end == token.c_str() + token.size())
+            {
+                if (errno != ERANGE)
+                {
+                    result = StackElement(StackElement::Number, static_cast<int64_t>(value));
+                    return true;
+                }
+
+                BigInteger big;
+                BigInteger::parse(token, big);
+                result = StackElement::makeBigInteger(big);
+                return true;
+            }
+
+            if (isDoubleLiteral(token))
+            {
+                result = StackElement::makeDouble(strtod(token.c_str(), nullptr));
+                return true;
+            }
+            return false;
+        }
+
+        std::string format(const StackElement& number)
+        {
+            switch (number.type())
+            {
+            case StackElement::Double:
+                {
+                    // the shortest of 15 to 17 significant digits that reads back exactly
+                    double value = number.doubleData();
+                    std::string text;
+                    for (int precision = 15; precision <= 17; precision++)
+                    {
+                        stringstream strBuilder;
+                        strBuilder << std::setprecision(precision) << value;
+                        text = strBuilder.str();
+                        if (strtod(text.c_str(), nullptr) == value)
+                        {
+                            break;
+                        }
+                    }
+
+                    if (std::isfinite(value) && text.find_first_of(".e") == std::string::npos)
+                    {
+                        text += ".0";
+                    }
+                    return text;
+                }
+            case StackElement::BigNumber:
+                return number.bigIntegerData()->toString();
+            default:
+                {
+                    stringstream strBuilder;
+                    strBuilder << number.numberData();
+                    return strBuilder.str();
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+namespace throf
+{
+    // Arithmetic and comparison over the numeric tower: Number (int64), BigNumber
+    // (arbitrary precision, see BigInteger) and Double.
+    //
+    // Two Numbers take the inline fast path in int64Arithmetic. Everything else, and
+    // the rare int64 operation that overflows, goes through arithmetic(), which widens
+    // to BigInteger and narrows the result back to a Number when it fits, so a script
+    // stays on the fast path unless its values really are big. A Double on either side
+    // makes the operation a double one.
+    //
+    // Integer division truncates, like C++; an integer division or modulo by zero throws.
+    // Doubles follow IEEE 754, division by zero giving an infinity or NaN.
+    namespace numeric
+    {
+        inline bool isNumeric(const StackElement& elem)
+        {
+            return elem.type() == StackElement::Number || elem.type() == StackElement::Double || elem.type() == StackElement::BigNumber;
+        }
+
+        // false when the result does not fit in an int64 or the division is not defined,
+        // leaving it to arithmetic()
+        inline bool int64Arithmetic(WORD_ID operation, int64_t left, int64_t right, int64_t& result)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            switch (operation)
+            {
+            case PRIM_ADD:
+                return !__builtin_add_overflow(left, right, &result);
+            case PRIM_SUB:
+                return !__builtin_sub_overflow(left, right, &result);
+            case PRIM_MUL:
+                return !__builtin_mul_overflow(left, right, &result);
+            }
+#else
+            switch (operation)
+            {
+            case PRIM_ADD:
+                if ((right > 0 && left > INT64_MAX - right) || (right < 0 && left < INT64_MIN - right))
+                {
+                    return false;
+                }
+                result = left + right;
+                return true;
+            case PRIM_SUB:
+                if ((right < 0 && left > INT64_MAX + right) || (right > 0 && left < INT64_MIN + right))
+                {
+                    return false;
+                }
+                result = left - right;
+                return true;
+            case PRIM_MUL:
+                result = static_cast<int64_t>(static_cast<uint64_t>(left) * static_cast<uint64_t>(right));
+                return left == 0 || (!(left == -1 && right == INT64_MIN) && result / left == right);
+            }
+#endif
+
+            // INT64_MIN / -1 overflows, and INT64_MIN % -1 is undefined along with it
+            if (right == 0 || (right == -1 && left == INT64_MIN))
+            {
+                return false;
+            }
+            result = (PRIM_DIV == operation) ? left / right : left % right;
+            return true;
+        }
+
+        // filename goes into the division by zero error
+        StackElement arithmetic(WORD_ID operation, const StackElement& left, const StackElement& right, const std::string& filename);
+
+        // NaN is neither less than nor equal to anything
+        bool less(const StackElement& left, const StackElement& right);
+        bool equal(const StackElement& left, const StackElement& right);
+
+        // Integer literals are Numbers, or BigNumbers past 64 bits. Double literals have
+        // a fraction, an exponent or both: 1.5, -0.25, 6.02e23, 1e-9.
+        bool parse(const std::string& token, StackElement& result);
+
+        // Doubles always show a fraction or an exponent, so what is printed reads back
+        // as the same value.
+        std::string format(const StackElement& number);
+
+        double toDouble(const StackElement& number);
+    }
+}
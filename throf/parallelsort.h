@@ -0,0 +1,112 @@
+#pragma once
+
+namespace throf
+{
+    // Sorting behind the array words. Inputs below PARALLEL_THRESHOLD elements are left
+    // to std::sort (an introsort). Larger ones are cut into one run per worker, the runs
+    // are sorted on their own threads, and then merged pairwise, a round at a time, the
+    // merges of a round again running in parallel. Workers come from the hardware
+    // concurrency, capped at MAX_WORKERS; THROF_SORT_THREADS in the environment
+    // overrides it.
+    //
+    // The result is not stable; callers that need stability sort on (key, index).
+    namespace parallelsort
+    {
+        static const size_t PARALLEL_THRESHOLD = 64 * 1024;
+        static const unsigned MAX_WORKERS = 16;
+
+        // a strict weak order over all doubles, NaNs sorting after everything else
+        inline bool doubleLess(double left, double right)
+        {
+            return left < right || (std::isnan(right) && !std::isnan(left));
+        }
+
+        inline unsigned workerCount()
+        {
+            static const unsigned s_workers = []()
+            {
+                const char* configured = getenv("THROF_SORT_THREADS");
+                unsigned workers = (nullptr != configured) ? static_cast<unsigned>(atoi(configured)) : std::thread::hardware_concurrency();
+                return std::max(1u, std::min(workers, MAX_WORKERS));
+            }();
+            return s_workers;
+        }
+
+        // runs job(0) .. job(count - 1), all but the first on threads of their own
+        template <class Job>
+        void runParallel(size_t count, Job job)
+        {
+            std::vector<std::thread> threads;
+            threads.reserve(count);
+            for (size_t ii = 1; ii < count; ii++)
+            {
+                threads.push_back(std::thread(job, ii));
+            }
+            job(0);
+            for (auto itr = threads.begin(); itr != threads.end(); itr++)
+            {
+                (*itr).join();
+            }
+        }
+
+        template <class T, class Less>
+        void sort(T* data, size_t count, Less less)
+        {
+            size_t runs = std::min<size_t>(workerCount(), count / PARALLEL_THRESHOLD);
+            if (runs < 2)
+            {
+                std::sort(data, data + count, less);
+                return;
+            }
+
+            // run ii is [bounds[ii], bounds[ii + 1])
+            std::vector<size_t> bounds;
+            for (size_t ii = 0; ii <= runs; ii++)
+            {
+                bounds.push_back(count * ii / runs);
+            }
+
+            runParallel(runs, [data, &bounds, less](size_t ii)
+            {
+                std::sort(data + bounds[ii], data + bounds[ii + 1], less);
+            });
+
+            std::vector<T, ResourceAllocator<T>> buffer(count);
+            T* from = data;
+            T* to = buffer.data();
+            while (bounds.size() > 2)
+            {
+                size_t pairs = (bounds.size() - 1) / 2;
+                runParallel(pairs, [from, to, &bounds, less](size_t ii)
+                {
+                    size_t first = bounds[2 * ii], middle = bounds[2 * ii + 1], last = bounds[2 * ii + 2];
+                    std::merge(from + first, from + middle, from + middle, from + last, to + first, less);
+                });
+
+                // an odd run out is carried over as it is
+                if ((bounds.size() - 1) % 2 == 1)
+                {
+                    size_t first = bounds[bounds.size() - 2], last = bounds.back();
+                    std::copy(from + first, from + last, to + first);
+                }
+
+                std::vector<size_t> merged;
+                for (size_t ii = 0; ii < bounds.size(); ii += 2)
+                {
+                    merged.push_back(bounds[ii]);
+                }
+                if (merged.back() != count)
+                {
+                    merged.push_back(count);
+                }
+                bounds.swap(merged);
+                std::swap(from, to);
+            }
+
+            if (from != data)
+            {
+                std::copy(from, from + count, data);
+            }
+        }
+    }
+}
@@ -0,0 +1,182 @@
+#include "stdafx.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+
+namespace throf
+{
+    using namespace std;
+
+    static const size_t ROOT_NODE = 0;
+
+    Profiler::Profiler() : _enabled(false)
+    {
+        reset();
+    }
+
+    unsigned long long Profiler::now()
+    {
+        return chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void Profiler::start()
+    {
+        _enabled = true;
+    }
+
+    // Frames that are still open keep being timed until they return, so turning the
+    // profiler off from inside a word still produces consistent totals.
+    void Profiler::stop()
+    {
+        _enabled = false;
+    }
+
+    void Profiler::reset()
+    {
+        _stats.clear();
+        _frames.clear();
+        _paths.clear();
+
+        PathNode root;
+        root.id = 0;
+        root.parent = ROOT_NODE;
+        root.exclusiveNs = 0;
+        _paths.push_back(root);
+    }
+
+    void Profiler::enter(WORD_ID id)
+    {
+        size_t parent = _frames.empty() ? ROOT_NODE : _frames.back().node;
+
+        size_t node;
+        auto child = _paths[parent].children.find(id);
+        if (child != _paths[parent].children.end())
+        {
+            node = (*child).second;
+        }
+        else
+        {
+            node = _paths.size();
+            _paths[parent].children[id] = node;
+
+            PathNode path;
+            path.id = id;
+            path.parent = parent;
+            path.exclusiveNs = 0;
+            _paths.push_back(path);
+        }
+
+        WordStats& stats = _stats[id];
+        stats.calls++;
+        stats.active++;
+
+        Frame frame;
+        frame.id = id;
+        frame.node = node;
+        frame.childNs = 0;
+        frame.startNs = now();
+        _frames.push_back(frame);
+    }
+
+    void Profiler::exit()
+    {
+        if (_frames.empty())
+        {
+            // profiling was reset while this word was running
+            return;
+        }
+
+        unsigned long long elapsed = now() - _frames.back().startNs;
+        Frame frame = _frames.back();
+        _frames.pop_back();
+
+        unsigned long long exclusive = elapsed - frame.childNs;
+        WordStats& stats = _stats[frame.id];
+        stats.exclusiveNs += exclusive;
+        if (--stats.active == 0)
+        {
+            stats.inclusiveNs += elapsed;
+        }
+
+        _paths[frame.node].exclusiveNs += exclusive;
+
+        if (!_frames.empty())
+        {
+            _frames.back().childNs += elapsed;
+        }
+    }
+
+    void Profiler::report(ostream& out, const WordNames& names) const
+    {
+        vector<pair<WORD_ID, WordStats>> sorted(_stats.begin(), _stats.end());
+        sort(sorted.begin(), sorted.end(), [](const pair<WORD_ID, WordStats>& left, const pair<WORD_ID, WordStats>& right)
+        {
+            return left.second.exclusiveNs > right.second.exclusiveNs;
+        });
+
+        unsigned long long totalNs = 0;
+        for (auto itr = sorted.cbegin(); itr != sorted.cend(); itr++)
+        {
+            totalNs += (*itr).second.exclusiveNs;
+        }
+
+        // formatted on the side, so the caller's stream keeps its own flags
+        stringstream report;
+        report << "Profile (words: " << sorted.size() << ", total: " << fixed << setprecision(3) << totalNs / 1e6 << " ms) :" << endl << endl;
+        report << setw(12) << "calls" << setw(14) << "incl ms" << setw(14) << "excl ms" << setw(9) << "excl %" << "  word" << endl;
+
+        for (auto itr = sorted.cbegin(); itr != sorted.cend(); itr++)
+        {
+            const WordStats& stats = (*itr).second;
+            auto name = names.find((*itr).first);
+
+            report << setw(12) << stats.calls;
+            report << setw(14) << stats.inclusiveNs / 1e6;
+            report << setw(14) << stats.exclusiveNs / 1e6;
+            report << setw(8) << (totalNs ? 100.0 * stats.exclusiveNs / totalNs : 0.0) << "%";
+            report << "  " << (name != names.end() ? (*name).second : "?") << endl;
+        }
+
+        report << endl;
+        out << report.str() << flush;
+    }
+
+    string Profiler::pathToString(size_t node, const WordNames& names) const
+    {
+        vector<WORD_ID> ids;
+        for (; node != ROOT_NODE; node = _paths[node].parent)
+        {
+            ids.push_back(_paths[node].id);
+        }
+
+        stringstream strBuilder;
+        for (auto itr = ids.rbegin(); itr != ids.rend(); itr++)
+        {
+            auto name = names.find(*itr);
+            strBuilder << (itr == ids.rbegin() ? "" : ";") << (name != names.end() ? (*name).second : "?");
+        }
+        return strBuilder.str();
+    }
+
+    // One "caller;...;callee <ns>" line per call path, the input format of
+    // flamegraph.pl and compatible tools.
+    void Profiler::writeFoldedStacks(const string& filename, const WordNames& names) const
+    {
+        ofstream out(filename.c_str());
+        if (!out)
+        {
+            stringstream strBuilder;
+            strBuilder << "could not open '" << filename << "' for writing, errno = " << errno;
+            throw ThrofException("Profiler", strBuilder.str());
+        }
+
+        for (size_t node = ROOT_NODE + 1; node < _paths.size(); node++)
+        {
+            if (_paths[node].exclusiveNs > 0)
+            {
+                out << pathToString(node, names) << " " << _paths[node].exclusiveNs << "\n";
+            }
+        }
+    }
+}
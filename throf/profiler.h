@@ -0,0 +1,91 @@
+#pragma once
+
+namespace throf
+{
+    // Instrumenting profiler behind --profile and the profile-on / profile-off /
+    // profile-report words. Every dispatched word (primitives included) is timed with
+    // the monotonic clock; per word we keep the call count plus inclusive and exclusive
+    // time, and per call path the exclusive time for folded-stack output.
+    //
+    // The hook in dispatch is a Profiler::Scope, which costs a single flag test when
+    // profiling is off.
+    class Profiler
+    {
+    public:
+        typedef unordered_map<WORD_ID, std::string> WordNames;
+
+        class Scope
+        {
+            Profiler& _profiler;
+            bool _active;
+
+            // block assignment
+            Scope& operator=(Scope& right) { return right; }
+
+        public:
+            Scope(Profiler& profiler, WORD_ID id) : _profiler(profiler), _active(profiler._enabled)
+            {
+                if (_active)
+                {
+                    _profiler.enter(id);
+                }
+            }
+
+            ~Scope()
+            {
+                if (_active)
+                {
+                    _profiler.exit();
+                }
+            }
+        };
+
+        Profiler();
+
+        void start();
+        void stop();
+        void reset();
+        bool enabled() const { return _enabled; }
+
+        void report(std::ostream& out, const WordNames& names) const;
+        void writeFoldedStacks(const std::string& filename, const WordNames& names) const;
+
+    private:
+        struct WordStats
+        {
+            unsigned long long calls;
+            unsigned long long inclusiveNs;
+            unsigned long long exclusiveNs;
+            int active; // recursion depth, so recursive words count inclusive time once
+
+            WordStats() : calls(0), inclusiveNs(0), exclusiveNs(0), active(0) { }
+        };
+
+        // one node per distinct call path
+        struct PathNode
+        {
+            WORD_ID id;
+            size_t parent;
+            unsigned long long exclusiveNs;
+            unordered_map<WORD_ID, size_t> children;
+        };
+
+        struct Frame
+        {
+            WORD_ID id;
+            size_t node;
+            unsigned long long startNs;
+            unsigned long long childNs;
+        };
+
+        void enter(WORD_ID id);
+        void exit();
+        static unsigned long long now();
+        std::string pathToString(size_t node, const WordNames& names) const;
+
+        bool _enabled;
+        unordered_map<WORD_ID, WordStats> _stats;
+        std::vector<PathNode> _paths;
+        std::vector<Frame> _frames;
+    };
+}
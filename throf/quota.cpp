@@ -0,0 +1,70 @@
+#include "stdafx.h"
+
+namespace throf
+{
+    using namespace std;
+
+    const unsigned long Quota::DEADLINE_CHECK_INTERVAL;
+
+    // with nothing to enforce the countdown only comes round once in a long while
+    static const unsigned long UNLIMITED_SLICE = 1UL << 30;
+
+    Quota::Quota() :
+        _maxStackDepth(SIZE_MAX),
+        _executed(0),
+        _slice(UNLIMITED_SLICE),
+        _countdown(UNLIMITED_SLICE)
+    {
+    }
+
+    void Quota::start(const Limits& limits)
+    {
+        _limits = limits;
+        _maxStackDepth = limits.stackDepth > 0 ? limits.stackDepth : SIZE_MAX;
+        _executed = 0;
+        _deadline = Clock::now() + chrono::milliseconds(limits.timeMs);
+
+        // the first slice is set up as if one just ran out
+        _slice = 0;
+        _countdown = 0;
+        refill();
+    }
+
+    void Quota::refill()
+    {
+        _executed += _slice;
+
+        // stays exhausted: until the next start() every word comes back here
+        _slice = 1;
+        _countdown = 1;
+
+        if (_limits.instructions > 0 && _executed > _limits.instructions)
+        {
+            stringstream strBuilder;
+            strBuilder << "instruction budget of " << _limits.instructions << " words exhausted";
+            throw QuotaExceeded("instructions", strBuilder.str());
+        }
+
+        if (_limits.timeMs > 0 && Clock::now() >= _deadline)
+        {
+            stringstream strBuilder;
+            strBuilder << "deadline of " << _limits.timeMs << " ms passed after " << _executed << " words";
+            throw QuotaExceeded("time", strBuilder.str());
+        }
+
+        // the slice ends exactly on the word that goes over the budget
+        _slice = _limits.timeMs > 0 ? DEADLINE_CHECK_INTERVAL : UNLIMITED_SLICE;
+        if (_limits.instructions > 0)
+        {
+            _slice = static_cast<unsigned long>(min<unsigned long long>(_slice, _limits.instructions - _executed + 1));
+        }
+        _countdown = _slice;
+    }
+
+    void Quota::throwStackDepthExceeded() const
+    {
+        stringstream strBuilder;
+        strBuilder << "data stack depth limit of " << _limits.stackDepth << " elements exceeded";
+        throw QuotaExceeded("stack depth", strBuilder.str());
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+namespace throf
+{
+    // Per-evaluation limits on what a script may use. Checking them has to cost next
+    // to nothing on the dispatch path, so executed words are counted with a countdown:
+    // tick() is a decrement and a compare, and only when the countdown runs out does
+    // refill() add up the instructions, read the clock for the deadline and start the
+    // next slice. The stack depth is compared on push and heap bytes are capped by a
+    // LimitedResource, both owned by the interpreter.
+    class Quota
+    {
+    public:
+        // zero means unlimited
+        struct Limits
+        {
+            unsigned long long instructions;
+            size_t stackDepth;
+            size_t memoryBytes;
+            unsigned long long timeMs;
+
+            Limits() : instructions(0), stackDepth(0), memoryBytes(0), timeMs(0) { }
+        };
+
+        // words executed between two reads of the clock when there is a deadline
+        static const unsigned long DEADLINE_CHECK_INTERVAL = 4096;
+
+        Quota();
+
+        // resets the counters and sets the deadline from now
+        void start(const Limits& limits);
+
+        const Limits& limits() const { return _limits; }
+        unsigned long long executedInstructions() const { return _executed + (_slice - _countdown); }
+
+        // once per dispatched word
+        void tick()
+        {
+            if (--_countdown == 0)
+            {
+                refill();
+            }
+        }
+
+        // largest stack allowed, SIZE_MAX when unlimited
+        size_t maxStackDepth() const { return _maxStackDepth; }
+        void throwStackDepthExceeded() const;
+
+    private:
+        void refill();
+
+        typedef std::chrono::steady_clock Clock;
+
+        Limits _limits;
+        size_t _maxStackDepth;
+        unsigned long long _executed;
+        unsigned long _slice;
+        unsigned long _countdown;
+        Clock::time_point _deadline;
+    };
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+namespace throf
+{
+    // Splits a stream into newline separated records for `throf -n`. Input is pulled
+    // in large chunks and records are handed out as [begin, end) ranges pointing into
+    // the chunk, so nothing is copied until the record becomes a stack element. A
+    // record straddling two chunks is moved to the front of the buffer before the
+    // next read.
+    class RecordReader
+    {
+        std::vector<char> _buffer;
+        size_t _begin;
+        size_t _end;
+        FILE* _file;
+        bool _eof;
+
+        bool refill()
+        {
+            if (_eof)
+            {
+                return false;
+            }
+
+            size_t pending = _end - _begin;
+            if (_begin > 0)
+            {
+                memmove(_buffer.data(), _buffer.data() + _begin, pending);
+                _begin = 0;
+                _end = pending;
+            }
+
+            // a single record longer than the buffer grows it
+            if (_end == _buffer.size())
+            {
+                _buffer.resize(_buffer.size() * 2);
+            }
+
+            size_t count = fread(_buffer.data() + _end, 1, _buffer.size() - _end, _file);
+            _end += count;
+            if (count == 0)
+            {
+                _eof = true;
+            }
+            return count > 0;
+        }
+
+    public:
+        explicit RecordReader(FILE* file, size_t chunkSize = 1 << 20) :
+            _buffer(chunkSize), _begin(0), _end(0), _file(file), _eof(false)
+        {
+        }
+
+        bool next(const char*& recordBegin, const char*& recordEnd)
+        {
+            for (;;)
+            {
+                const char* start = _buffer.data() + _begin;
+                const char* newline = static_cast<const char*>(memchr(start, '\n', _end - _begin));
+
+                if (nullptr != newline)
+                {
+                    recordBegin = start;
+                    recordEnd = newline;
+                    _begin += (newline - start) + 1;
+                    return true;
+                }
+
+                if (!refill())
+                {
+                    // final record without a trailing newline
+                    if (_begin == _end)
+                    {
+                        return false;
+                    }
+
+                    recordBegin = _buffer.data() + _begin;
+                    recordEnd = _buffer.data() + _end;
+                    _begin = _end;
+                    return true;
+                }
+            }
+        }
+    };
+}
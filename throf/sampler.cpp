@@ -0,0 +1,279 @@
+#include "stdafx.h"
+#include <fstream>
+#include <iomanip>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/time.h>
+#endif
+
+namespace throf
+{
+    using namespace std;
+
+    const int Sampler::DEFAULT_FREQUENCY;
+    const size_t Sampler::SHADOW_STACK_SIZE;
+    const size_t Sampler::MAX_SAMPLE_FRAMES;
+    const size_t Sampler::RING_SIZE;
+    const WORD_ID Sampler::TRUNCATED_MARKER;
+
+    static atomic<Sampler*> s_activeSampler(nullptr);
+
+    Sampler::Sampler() :
+        _enabled(false),
+        _depth(0),
+        _ringHead(0),
+        _ringTail(0),
+        _drainRequested(false),
+        _dropped(0),
+        _totalSamples(0)
+    {
+    }
+
+    Sampler::~Sampler()
+    {
+        if (_enabled)
+        {
+            stop();
+        }
+    }
+
+#ifndef _WIN32
+    void Sampler::start(int frequency)
+    {
+        if (_enabled)
+        {
+            return;
+        }
+
+        ThrofException::throwIfTrue(frequency <= 0 || frequency > 10000, "Sampler",
+            "sampling frequency must be between 1 and 10000 Hz");
+
+        Sampler* expected = nullptr;
+        ThrofException::throwIfTrue(!s_activeSampler.compare_exchange_strong(expected, this), "Sampler",
+            "another sampler is already running in this process");
+
+        // everything the handler touches is allocated up front
+        if (_shadowStack.empty())
+        {
+            _shadowStack.resize(SHADOW_STACK_SIZE);
+            _ring.resize(RING_SIZE);
+        }
+        _enabled = true;
+
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = &Sampler::onSignal;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGPROF, &action, nullptr);
+
+        struct itimerval timer;
+        // tv_usec has to stay below a second, so 1 Hz is a whole second and no micros
+        timer.it_interval.tv_sec = 1 / frequency;
+        timer.it_interval.tv_usec = (1000000 / frequency) % 1000000;
+        timer.it_value = timer.it_interval;
+        if (setitimer(ITIMER_PROF, &timer, nullptr) < 0)
+        {
+            _enabled = false;
+            s_activeSampler.store(nullptr);
+
+            stringstream strBuilder;
+            strBuilder << "setitimer failed, errno = " << errno;
+            throw ThrofException("Sampler", strBuilder.str());
+        }
+    }
+
+    void Sampler::stop()
+    {
+        if (!_enabled)
+        {
+            return;
+        }
+
+        struct itimerval timer;
+        memset(&timer, 0, sizeof(timer));
+        setitimer(ITIMER_PROF, &timer, nullptr);
+        signal(SIGPROF, SIG_IGN);
+
+        _enabled = false;
+        s_activeSampler.store(nullptr);
+        drain();
+    }
+#else
+    void Sampler::start(int)
+    {
+        throw ThrofException("Sampler", "sampling profiler is not supported on this platform");
+    }
+
+    void Sampler::stop()
+    {
+    }
+#endif
+
+    void Sampler::onSignal(int)
+    {
+        Sampler* sampler = s_activeSampler.load();
+        if (nullptr != sampler)
+        {
+            int savedErrno = errno;
+            sampler->takeSample();
+            errno = savedErrno;
+        }
+    }
+
+    // Runs inside the signal handler: no allocation, no locks. A sample is written
+    // to the ring as [frame count, outermost id, ..., innermost id].
+    void Sampler::takeSample()
+    {
+        size_t depth = _depth.load(memory_order_relaxed);
+        atomic_signal_fence(memory_order_acquire);
+
+        if (depth > SHADOW_STACK_SIZE)
+        {
+            depth = SHADOW_STACK_SIZE;
+        }
+
+        bool truncated = depth > MAX_SAMPLE_FRAMES;
+        size_t count = truncated ? MAX_SAMPLE_FRAMES : depth;
+        size_t first = depth - count;
+        size_t needed = count + 1 + (truncated ? 1 : 0);
+
+        size_t head = _ringHead.load(memory_order_relaxed);
+        size_t tail = _ringTail.load(memory_order_acquire);
+        if (RING_SIZE - (head - tail) < needed)
+        {
+            _dropped++;
+            _drainRequested.store(true, memory_order_relaxed);
+            return;
+        }
+
+        _ring[head++ % RING_SIZE] = static_cast<WORD_ID>(needed - 1);
+        if (truncated)
+        {
+            _ring[head++ % RING_SIZE] = TRUNCATED_MARKER;
+        }
+        for (size_t ii = first; ii < depth; ii++)
+        {
+            _ring[head++ % RING_SIZE] = _shadowStack[ii];
+        }
+        _ringHead.store(head, memory_order_release);
+
+        if (head - tail > RING_SIZE / 2)
+        {
+            _drainRequested.store(true, memory_order_relaxed);
+        }
+    }
+
+    void Sampler::drain()
+    {
+        _drainRequested.store(false, memory_order_relaxed);
+
+        size_t head = _ringHead.load(memory_order_acquire);
+        size_t tail = _ringTail.load(memory_order_relaxed);
+
+        vector<WORD_ID> path;
+        while (tail != head)
+        {
+            size_t count = static_cast<size_t>(_ring[tail++ % RING_SIZE]);
+            path.clear();
+            for (size_t ii = 0; ii < count; ii++)
+            {
+                path.push_back(_ring[tail++ % RING_SIZE]);
+            }
+
+            _paths[path]++;
+            _totalSamples++;
+        }
+
+        _ringTail.store(tail, memory_order_release);
+    }
+
+    void Sampler::report(ostream& out, const WordNames& names)
+    {
+        drain();
+
+        // self: the word was on top of the shadow stack; total: anywhere on it
+        unordered_map<WORD_ID, pair<unsigned long long, unsigned long long>> words;
+        for (auto itr = _paths.cbegin(); itr != _paths.cend(); itr++)
+        {
+            const vector<WORD_ID>& path = (*itr).first;
+            unsigned long long samples = (*itr).second;
+            if (path.empty())
+            {
+                continue;
+            }
+
+            words[path.back()].first += samples;
+
+            unordered_set<WORD_ID> seen;
+            for (auto jtr = path.cbegin(); jtr != path.cend(); jtr++)
+            {
+                if (seen.insert(*jtr).second)
+                {
+                    words[*jtr].second += samples;
+                }
+            }
+        }
+        words.erase(TRUNCATED_MARKER);
+
+        typedef pair<WORD_ID, pair<unsigned long long, unsigned long long>> WordSamples;
+        vector<WordSamples> sorted(words.begin(), words.end());
+        sort(sorted.begin(), sorted.end(), [](const WordSamples& left, const WordSamples& right)
+        {
+            return left.second.first > right.second.first ||
+                (left.second.first == right.second.first && left.second.second > right.second.second);
+        });
+
+        // formatted on the side, so the caller's stream keeps its own flags
+        stringstream report;
+        report << "Samples (total: " << _totalSamples << ", dropped: " << _dropped.load();
+        report << ", call paths: " << _paths.size() << ") :" << endl << endl;
+        report << setw(10) << "self" << setw(9) << "self %" << setw(10) << "total" << setw(9) << "total %" << "  word" << endl;
+
+        report << fixed << setprecision(2);
+        for (auto itr = sorted.cbegin(); itr != sorted.cend(); itr++)
+        {
+            auto name = names.find((*itr).first);
+            unsigned long long self = (*itr).second.first;
+            unsigned long long total = (*itr).second.second;
+
+            report << setw(10) << self << setw(8) << (_totalSamples ? 100.0 * self / _totalSamples : 0.0) << "%";
+            report << setw(10) << total << setw(8) << (_totalSamples ? 100.0 * total / _totalSamples : 0.0) << "%";
+            report << "  " << (name != names.end() ? (*name).second : "?") << endl;
+        }
+
+        report << endl;
+        out << report.str() << flush;
+    }
+
+    void Sampler::writeFoldedStacks(const string& filename, const WordNames& names)
+    {
+        drain();
+
+        ofstream out(filename.c_str());
+        if (!out)
+        {
+            stringstream strBuilder;
+            strBuilder << "could not open '" << filename << "' for writing, errno = " << errno;
+            throw ThrofException("Sampler", strBuilder.str());
+        }
+
+        for (auto itr = _paths.cbegin(); itr != _paths.cend(); itr++)
+        {
+            const vector<WORD_ID>& path = (*itr).first;
+            if (path.empty())
+            {
+                out << "(interpreter)";
+            }
+
+            for (auto jtr = path.cbegin(); jtr != path.cend(); jtr++)
+            {
+                auto name = names.find(*jtr);
+                out << (jtr == path.cbegin() ? "" : ";");
+                out << (*jtr == TRUNCATED_MARKER ? "..." : (name != names.end() ? (*name).second : "?"));
+            }
+            out << " " << (*itr).second << "\n";
+        }
+    }
+}
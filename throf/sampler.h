@@ -0,0 +1,105 @@
+#pragma once
+
+namespace throf
+{
+    // Statistical profiler behind --sample and the sample-on / sample-off /
+    // sample-report words. While it runs, dispatch keeps a shadow stack of the word ids
+    // being executed; a SIGPROF timer (setitimer ITIMER_PROF) interrupts the process
+    // and the handler copies the innermost frames of that stack into a lock-free ring.
+    // The ring is drained into per-word and per-call-path histograms outside of the
+    // signal handler, either when it fills past half or when a report is asked for.
+    //
+    // Only one Sampler per process can be running at a time, since the signal handler
+    // is process wide.
+    class Sampler
+    {
+    public:
+        typedef unordered_map<WORD_ID, std::string> WordNames;
+
+        static const int DEFAULT_FREQUENCY = 199;
+
+        class Scope
+        {
+            Sampler& _sampler;
+            bool _active;
+
+            // block assignment
+            Scope& operator=(Scope& right) { return right; }
+
+        public:
+            Scope(Sampler& sampler, WORD_ID id) : _sampler(sampler), _active(sampler._enabled)
+            {
+                if (_active)
+                {
+                    _sampler.push(id);
+                }
+            }
+
+            ~Scope()
+            {
+                if (_active)
+                {
+                    _sampler.pop();
+                }
+            }
+        };
+
+        Sampler();
+        ~Sampler();
+
+        void start(int frequency);
+        void stop();
+        bool enabled() const { return _enabled; }
+
+        void report(std::ostream& out, const WordNames& names);
+        void writeFoldedStacks(const std::string& filename, const WordNames& names);
+
+    private:
+        static const size_t SHADOW_STACK_SIZE = 16384;
+        static const size_t MAX_SAMPLE_FRAMES = 64;
+        static const size_t RING_SIZE = 1 << 20;
+        static const WORD_ID TRUNCATED_MARKER = 0x7fffffff;
+
+        void push(WORD_ID id)
+        {
+            size_t depth = _depth.load(std::memory_order_relaxed);
+            if (depth < SHADOW_STACK_SIZE)
+            {
+                _shadowStack[depth] = id;
+            }
+            std::atomic_signal_fence(std::memory_order_release);
+            _depth.store(depth + 1, std::memory_order_relaxed);
+        }
+
+        void pop()
+        {
+            _depth.store(_depth.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+            if (_drainRequested.load(std::memory_order_relaxed))
+            {
+                drain();
+            }
+        }
+
+        static void onSignal(int signal);
+        void takeSample();
+        void drain();
+
+        // block assignment
+        Sampler& operator=(Sampler& right) { return right; }
+
+        bool _enabled;
+
+        // shared with the signal handler
+        std::vector<WORD_ID> _shadowStack;
+        std::atomic<size_t> _depth;
+        std::vector<WORD_ID> _ring;
+        std::atomic<size_t> _ringHead;
+        std::atomic<size_t> _ringTail;
+        std::atomic<bool> _drainRequested;
+        std::atomic<unsigned long long> _dropped;
+
+        // aggregated histograms, only touched outside the handler
+        unsigned long long _totalSamples;
+        std::map<std::vector<WORD_ID>, unsigned long long> _paths;
+    };
+}
@@ -0,0 +1,255 @@
+// throf-servecheck : starts `throf --serve` on a temporary socket and checks the
+// framing and the request handling end to end.
+//
+//   throf-servecheck [--throf <binary>]
+//
+// Requests and responses are framed as a 4 byte big endian length followed by the
+// payload; a response payload is a status byte, '0' or '1', and the output. One line
+// is printed per check:
+//
+//   check  status
+//
+// status is ok or FAILED. The exit code is 1 if any check failed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include <string>
+
+static const int CONNECT_ATTEMPTS = 100;
+static const useconds_t CONNECT_RETRY_US = 50 * 1000;
+
+static bool writeFully(int fd, const char* buf, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t count = write(fd, buf, size);
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            return false;
+        }
+        buf += count;
+        size -= count;
+    }
+    return true;
+}
+
+static bool readFully(int fd, char* buf, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t count = read(fd, buf, size);
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            return false;
+        }
+        buf += count;
+        size -= count;
+    }
+    return true;
+}
+
+// memoryLimit, if given, is passed on as --memory-limit
+static pid_t spawn(const std::string& throf, const char* socketPath, const char* memoryLimit = nullptr)
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        int devNull = open("/dev/null", O_WRONLY);
+        if (devNull >= 0)
+        {
+            dup2(devNull, STDOUT_FILENO);
+            dup2(devNull, STDERR_FILENO);
+            close(devNull);
+        }
+        if (nullptr != memoryLimit)
+        {
+            execl(throf.c_str(), throf.c_str(), "--memory-limit", memoryLimit, "--serve", socketPath, (char*)nullptr);
+        }
+        else
+        {
+            execl(throf.c_str(), throf.c_str(), "--serve", socketPath, (char*)nullptr);
+        }
+        _exit(127);
+    }
+    return pid;
+}
+
+// the server needs a moment to load init.th4 and bind, so this retries for a while
+static int connectTo(const char* socketPath)
+{
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath, sizeof(addr.sun_path) - 1);
+
+    for (int ii = 0; ii < CONNECT_ATTEMPTS; ii++)
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            return -1;
+        }
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0)
+        {
+            return fd;
+        }
+        close(fd);
+        usleep(CONNECT_RETRY_US);
+    }
+    return -1;
+}
+
+// sends one request and reads its response; false if the connection broke
+static bool request(int fd, const std::string& source, char& status, std::string& output)
+{
+    size_t length = source.size();
+    unsigned char header[4] =
+    {
+        static_cast<unsigned char>(length >> 24),
+        static_cast<unsigned char>(length >> 16),
+        static_cast<unsigned char>(length >> 8),
+        static_cast<unsigned char>(length)
+    };
+    if (!writeFully(fd, reinterpret_cast<const char*>(header), sizeof(header)) || !writeFully(fd, source.data(), length))
+    {
+        return false;
+    }
+
+    if (!readFully(fd, reinterpret_cast<char*>(header), sizeof(header)))
+    {
+        return false;
+    }
+    length = (size_t(header[0]) << 24) | (size_t(header[1]) << 16) | (size_t(header[2]) << 8) | size_t(header[3]);
+    if (length == 0)
+    {
+        return false;
+    }
+
+    std::string payload(length, '\0');
+    if (!readFully(fd, &payload[0], length))
+    {
+        return false;
+    }
+    status = payload[0];
+    output = payload.substr(1);
+    return true;
+}
+
+static bool report(const char* check, bool passed)
+{
+    printf("%s\t%s\n", check, passed ? "ok" : "FAILED");
+    fflush(stdout);
+    return passed;
+}
+
+// a request that evaluates leaves status '0' and its stack in the output; one that
+// fails leaves '1' and the error
+static bool checkRequest(int fd, const char* check, const std::string& source, char expectedStatus, const char* expectedOutput)
+{
+    char status = 0;
+    std::string output;
+    bool passed = request(fd, source, status, output) && status == expectedStatus &&
+        output.find(expectedOutput) != std::string::npos;
+    return report(check, passed);
+}
+
+int main(int argc, char* argv[])
+{
+    std::string throf = "throf/throf";
+    for (int ii = 1; ii < argc; ii++)
+    {
+        if (0 == strcmp(argv[ii], "--throf") && ii + 1 < argc)
+        {
+            throf = argv[++ii];
+        }
+        else
+        {
+            fprintf(stderr, "usage: throf-servecheck [--throf <binary>]\n");
+            return 1;
+        }
+    }
+
+    // a client going away must not take the checker down either
+    signal(SIGPIPE, SIG_IGN);
+
+    char socketPath[64];
+    snprintf(socketPath, sizeof(socketPath), "/tmp/throf-servecheck-%d.sock", static_cast<int>(getpid()));
+
+    pid_t server = spawn(throf, socketPath);
+    if (server < 0)
+    {
+        fprintf(stderr, "ERROR: fork failed, errno = %d\n", errno);
+        return 1;
+    }
+
+    bool passed = true;
+    int fd = connectTo(socketPath);
+    passed &= report("connect", fd >= 0);
+    if (fd >= 0)
+    {
+        // several requests share a connection, each against a fresh copy of the server
+        passed &= checkRequest(fd, "evaluate", "1 2 +", '0', "3");
+        passed &= checkRequest(fd, "error", "1 0 /", '1', "ERROR:");
+        passed &= checkRequest(fd, "after error", ": sq dup * ; 7 sq", '0', "49");
+        passed &= checkRequest(fd, "fresh state", "sq", '1', "ERROR:");
+        passed &= checkRequest(fd, "empty request", "", '0', "Stack");
+        passed &= checkRequest(fd, "std exception", "\"x\" 64 [ dup concat ] times", '1', "ERROR:");
+        close(fd);
+    }
+
+    kill(server, SIGTERM);
+    while (waitpid(server, nullptr, 0) < 0 && errno == EINTR)
+    {
+    }
+    unlink(socketPath);
+
+    // the request arena never frees, so --memory-limit caps everything a request
+    // allocated, not just what it still holds at the end
+    server = spawn(throf, socketPath, "1000000");
+    fd = server < 0 ? -1 : connectTo(socketPath);
+    if (fd >= 0)
+    {
+        passed &= checkRequest(fd, "memory limit", "\"a\" 3000000 [ dup \"b\" concat drop ] times", '1', "memory limit");
+        close(fd);
+    }
+    else
+    {
+        passed &= report("memory limit", false);
+    }
+
+    if (server > 0)
+    {
+        kill(server, SIGTERM);
+    }
+    while (server > 0 && waitpid(server, nullptr, 0) < 0 && errno == EINTR)
+    {
+    }
+    unlink(socketPath);
+
+    // a socket that cannot be bound is reported and fails the run
+    pid_t unbound = spawn(throf, "/nonexistent/throf-servecheck.sock");
+    int status = 0;
+    while (unbound > 0 && waitpid(unbound, &status, 0) < 0 && errno == EINTR)
+    {
+    }
+    passed &= report("bind failure", unbound > 0 && WIFEXITED(status) && WEXITSTATUS(status) != 0);
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,265 @@
+#include "stdafx.h"
+#include <iostream>
+
+#ifndef _WIN32
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+namespace throf
+{
+    using namespace std;
+
+    static const size_t MAX_REQUEST_SIZE = 16 * 1024 * 1024;
+    static const size_t MAX_WORKERS = 64;
+
+    static void throwErrno(const char* call)
+    {
+        stringstream strBuilder;
+        strBuilder << call << " failed, errno = " << errno;
+        throw ThrofException("Server", strBuilder.str());
+    }
+
+    static bool readFully(int fd, char* buf, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t count = ::read(fd, buf, size);
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (count <= 0)
+            {
+                return false;
+            }
+            buf += count;
+            size -= count;
+        }
+        return true;
+    }
+
+    static bool writeFully(int fd, const char* buf, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t count = ::write(fd, buf, size);
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (count <= 0)
+            {
+                return false;
+            }
+            buf += count;
+            size -= count;
+        }
+        return true;
+    }
+
+    Server::Server(Interpreter& interpreter, const string& socketPath) :
+        _interpreter(interpreter), _socketPath(socketPath), _listenFd(-1), _activeWorkers(0)
+    {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        ThrofException::throwIfTrue(_socketPath.size() >= sizeof(addr.sun_path), "Server",
+            "unix socket path is too long : " + _socketPath);
+        strncpy(addr.sun_path, _socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+        _listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (_listenFd < 0)
+        {
+            throwErrno("socket");
+        }
+
+        unlink(_socketPath.c_str());
+        if (bind(_listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(_listenFd, SOMAXCONN) < 0)
+        {
+            // the destructor does not run for a constructor that throws
+            int error = errno;
+            ::close(_listenFd);
+            _listenFd = -1;
+            errno = error;
+            throwErrno("bind/listen");
+        }
+
+        // clients going away mid-response must not take the server down
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+    Server::~Server()
+    {
+        if (_listenFd >= 0)
+        {
+            ::close(_listenFd);
+            unlink(_socketPath.c_str());
+        }
+    }
+
+    void Server::reapWorkers(bool block)
+    {
+        int status;
+        while (_activeWorkers > 0 && waitpid(-1, &status, block ? 0 : WNOHANG) > 0)
+        {
+            _activeWorkers--;
+            block = false;
+        }
+    }
+
+    void Server::run()
+    {
+        for (;;)
+        {
+            reapWorkers(_activeWorkers >= MAX_WORKERS);
+
+            int client = accept(_listenFd, nullptr, nullptr);
+            if (client < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED)
+                {
+                    continue;
+                }
+                throwErrno("accept");
+            }
+
+            pid_t pid = fork();
+            if (pid < 0)
+            {
+                ::close(client);
+                throwErrno("fork");
+            }
+            else if (pid == 0)
+            {
+                ::close(_listenFd);
+                serveConnection(client);
+                _exit(0);
+            }
+
+            _activeWorkers++;
+            ::close(client);
+        }
+    }
+
+    void Server::serveConnection(int fd)
+    {
+        string request;
+        while (readRequest(fd, request))
+        {
+            pid_t pid = fork();
+            if (pid < 0)
+            {
+                writeResponse(fd, '1', "fork failed while evaluating request");
+                continue;
+            }
+            else if (pid == 0)
+            {
+                // the request runs against a copy-on-write snapshot of the warm interpreter
+                char status = '0';
+                string text = evaluate(request, status);
+                writeResponse(fd, status, text);
+                _exit(0);
+            }
+
+            int status;
+            while (waitpid(pid, &status, 0) < 0 && errno == EINTR) { }
+
+            // the child may have died halfway through its response, so another frame
+            // could not be told apart from the rest of it; the client sees the
+            // connection close instead
+            if (!WIFEXITED(status))
+            {
+                break;
+            }
+        }
+        ::close(fd);
+    }
+
+    bool Server::readRequest(int fd, string& request)
+    {
+        unsigned char header[4];
+        if (!readFully(fd, reinterpret_cast<char*>(header), sizeof(header)))
+        {
+            return false;
+        }
+
+        size_t length = (size_t(header[0]) << 24) | (size_t(header[1]) << 16) | (size_t(header[2]) << 8) | size_t(header[3]);
+        if (length > MAX_REQUEST_SIZE)
+        {
+            writeResponse(fd, '1', "request exceeds maximum size");
+            return false;
+        }
+
+        request.resize(length);
+        return length == 0 || readFully(fd, &request[0], length);
+    }
+
+    void Server::writeResponse(int fd, char status, const string& text)
+    {
+        size_t length = text.size() + 1;
+        unsigned char header[4] =
+        {
+            static_cast<unsigned char>(length >> 24),
+            static_cast<unsigned char>(length >> 16),
+            static_cast<unsigned char>(length >> 8),
+            static_cast<unsigned char>(length)
+        };
+
+        if (writeFully(fd, reinterpret_cast<const char*>(header), sizeof(header)) && writeFully(fd, &status, 1))
+        {
+            writeFully(fd, text.data(), text.size());
+        }
+    }
+
+    string Server::evaluate(const string& request, char& status)
+    {
+        stringstream output;
+        streambuf* original = cout.rdbuf(output.rdbuf());
+
+        try
+        {
+            InputReader reader(request, true);
+            Tokenizer tokenizer = Tokenizer::tokenize(reader);
+            _interpreter.evaluate(tokenizer, &_requestArena);
+            output << _interpreter.stackToString();
+        }
+        catch (const ThrofException& e)
+        {
+            status = '1';
+            output << "ERROR: component: " << e.component() << endl;
+            output << "ERROR: explanation: " << e.what() << endl;
+        }
+        catch (const exception& e)
+        {
+            // anything else, bad_alloc, length_error and the like, fails the request
+            // rather than the worker
+            status = '1';
+            output << "ERROR: explanation: " << e.what() << endl;
+        }
+
+        cout.rdbuf(original);
+        _requestArena.rewind();
+        return output.str();
+    }
+}
+
+#else
+
+namespace throf
+{
+    Server::Server(Interpreter& interpreter, const std::string& socketPath) :
+        _interpreter(interpreter), _socketPath(socketPath), _listenFd(-1), _activeWorkers(0)
+    {
+        throw ThrofException("Server", "--serve is not supported on this platform");
+    }
+
+    Server::~Server() { }
+
+    void Server::run() { }
+}
+
+#endif
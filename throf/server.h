@@ -0,0 +1,46 @@
+#pragma once
+
+namespace throf
+{
+    // Evaluation daemon for `throf --serve <socket path>`.
+    //
+    // The server keeps one warm interpreter (init.th4 and any preloaded files already
+    // compiled) and listens on a Unix domain socket. Each connection is handled by a
+    // forked worker so connections run concurrently, and every request is evaluated in
+    // a further fork of that worker so no request can observe another one's stack,
+    // variables or definitions.
+    //
+    // Wire format, all lengths are 4 byte big-endian:
+    //   request  : <length> <throf source>
+    //   response : <length> <status byte> <text>
+    // The status byte is '0' on success and '1' if evaluation raised an error. The text
+    // is whatever the request printed followed by the final stack (as shown by the
+    // `stack` word), or the error description.
+    //
+    // Values a request creates while it runs are allocated from a per-request arena and
+    // released all at once when the response has been written.
+    class Server
+    {
+    public:
+        Server(Interpreter& interpreter, const std::string& socketPath);
+        ~Server();
+
+        void run();
+
+    private:
+        void serveConnection(int fd);
+        bool readRequest(int fd, std::string& request);
+        void writeResponse(int fd, char status, const std::string& text);
+        std::string evaluate(const std::string& request, char& status);
+        void reapWorkers(bool block);
+
+        // block assignment
+        Server& operator=(Server& right) { return right; }
+
+        Interpreter& _interpreter;
+        std::string _socketPath;
+        int _listenFd;
+        size_t _activeWorkers;
+        ArenaResource _requestArena;
+    };
+}
@@ -0,0 +1,651 @@
+#include "stdafx.h"
+
+#if defined(THROF_HAS_X86_SIMD) && !defined(_MSC_VER)
+#define THROF_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define THROF_TARGET_AVX2
+#endif
+
+namespace throf
+{
+    namespace simd
+    {
+        // integer arithmetic goes through uint64_t so that overflow wraps instead of
+        // being undefined
+        static inline int64_t wrappingAdd(int64_t left, int64_t right)
+        {
+            return static_cast<int64_t>(static_cast<uint64_t>(left) + static_cast<uint64_t>(right));
+        }
+
+        static inline int64_t wrappingMul(int64_t left, int64_t right)
+        {
+            return static_cast<int64_t>(static_cast<uint64_t>(left) * static_cast<uint64_t>(right));
+        }
+
+        // scalar kernels, also used for the tails the vector loops leave over
+
+        static void addInt64Scalar(const int64_t* left, const int64_t* right, int64_t* out, size_t count)
+        {
+            for (size_t ii = 0; ii < count; ii++)
+            {
+                out[ii] = wrappingAdd(left[ii], right[ii]);
+            }
+        }
+
+        static void mulInt64Scalar(const int64_t* left, const int64_t* right, int64_t* out, size_t count)
+        {
+            for (size_t ii = 0; ii < count; ii++)
+            {
+                out[ii] = wrappingMul(left[ii], right[ii]);
+            }
+        }
+
+        static int64_t sumInt64Scalar(const int64_t* values, size_t count)
+        {
+            int64_t sum = 0;
+            for (size_t ii = 0; ii < count; ii++)
+            {
+                sum = wrappingAdd(sum, values[ii]);
+            }
+            return sum;
+        }
+
+        static int64_t dotInt64Scalar(const int64_t* left, const int64_t* right, size_t count)
+        {
+            int64_t sum = 0;
+            for (size_t ii = 0; ii < count; ii++)
+            {
+                sum = wrappingAdd(sum, wrappingMul(left[ii], right[ii]));
+            }
+            return sum;
+        }
+
+        static int64_t minInt64Scalar(const int64_t* values, size_t count)
+        {
+            int64_t result = values[0];
+            for (size_t ii = 1; ii < count; ii++)
+            {
+                result = values[ii] < result ? values[ii] : result;
+            }
+            return result;
+        }
+
+        static int64_t maxInt64Scalar(const int64_t* values, size_t count)
+        {
+            int64_t result = values[0];
+            for (size_t ii = 1; ii < count; ii++)
+            {
+                result = values[ii] > result ? values[ii] : result;
+            }
+            return result;
+        }
+
+        static void affineInt64Scalar(const int64_t* values, int64_t scale, int64_t offset, int64_t* out, size_t count)
+        {
+            for (size_t ii = 0; ii < count; ii++)
+            {
+                out[ii] = wrappingAdd(wrappingMul(values[ii], scale), offset);
+            }
+        }
+
+        static void addDoubleScalar(const double* left, const double* right, double* out, size_t count)
+        {
+            for (size_t ii = 0; ii < count; ii++)
+            {
+                out[ii] = left[ii] + right[ii];
+            }
+        }
+
+        static void mulDoubleScalar(const double* left, const double* right, double* out, size_t count)
+        {
+            for (size_t ii = 0; ii < count; ii++)
+            {
+                out[ii] = left[ii] * right[ii];
+            }
+        }
+
+        static double sumDoubleScalar(const double* values, size_t count)
+        {
+            double sum = 0;
+            for (size_t ii = 0; ii < count; ii++)
+            {
+                sum += values[ii];
+            }
+            return sum;
+        }
+
+        static double dotDoubleScalar(const double* left, const double* right, size_t count)
+        {
+            double sum = 0;
+            for (size_t ii = 0; ii < count; ii++)
+            {
+                sum += left[ii] * right[ii];
+            }
+            return sum;
+        }
+
+        static double minDoubleScalar(const double* values, size_t count)
+        {
+            double result = values[0];
+            for (size_t ii = 1; ii < count; ii++)
+            {
+                result = values[ii] < result ? values[ii] : result;
+            }
+            return result;
+        }
+
+        static double maxDoubleScalar(const double* values, size_t count)
+        {
+            double result = values[0];
+            for (size_t ii = 1; ii < count; ii++)
+            {
+                result = values[ii] > result ? values[ii] : result;
+            }
+            return result;
+        }
+
+        static void affineDoubleScalar(const double* values, double scale, double offset, double* out, size_t count)
+        {
+            for (size_t ii = 0; ii < count; ii++)
+            {
+                out[ii] = values[ii] * scale + offset;
+            }
+        }
+
+#ifdef THROF_HAS_X86_SIMD
+        // SSE2, two lanes
+
+        static void addInt64SSE2(const int64_t* left, const int64_t* right, int64_t* out, size_t count)
+        {
+            size_t ii = 0;
+            for (; ii + 2 <= count; ii += 2)
+            {
+                __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + ii));
+                __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(right + ii));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + ii), _mm_add_epi64(l, r));
+            }
+            addInt64Scalar(left + ii, right + ii, out + ii, count - ii);
+        }
+
+        static int64_t sumInt64SSE2(const int64_t* values, size_t count)
+        {
+            __m128i acc = _mm_setzero_si128();
+            size_t ii = 0;
+            for (; ii + 2 <= count; ii += 2)
+            {
+                acc = _mm_add_epi64(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + ii)));
+            }
+
+            int64_t lanes[2];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+            return wrappingAdd(wrappingAdd(lanes[0], lanes[1]), sumInt64Scalar(values + ii, count - ii));
+        }
+
+        static void addDoubleSSE2(const double* left, const double* right, double* out, size_t count)
+        {
+            size_t ii = 0;
+            for (; ii + 2 <= count; ii += 2)
+            {
+                _mm_storeu_pd(out + ii, _mm_add_pd(_mm_loadu_pd(left + ii), _mm_loadu_pd(right + ii)));
+            }
+            addDoubleScalar(left + ii, right + ii, out + ii, count - ii);
+        }
+
+        static void mulDoubleSSE2(const double* left, const double* right, double* out, size_t count)
+        {
+            size_t ii = 0;
+            for (; ii + 2 <= count; ii += 2)
+            {
+                _mm_storeu_pd(out + ii, _mm_mul_pd(_mm_loadu_pd(left + ii), _mm_loadu_pd(right + ii)));
+            }
+            mulDoubleScalar(left + ii, right + ii, out + ii, count - ii);
+        }
+
+        static double sumDoubleSSE2(const double* values, size_t count)
+        {
+            __m128d acc = _mm_setzero_pd();
+            size_t ii = 0;
+            for (; ii + 2 <= count; ii += 2)
+            {
+                acc = _mm_add_pd(acc, _mm_loadu_pd(values + ii));
+            }
+
+            double lanes[2];
+            _mm_storeu_pd(lanes, acc);
+            return lanes[0] + lanes[1] + sumDoubleScalar(values + ii, count - ii);
+        }
+
+        static double dotDoubleSSE2(const double* left, const double* right, size_t count)
+        {
+            __m128d acc = _mm_setzero_pd();
+            size_t ii = 0;
+            for (; ii + 2 <= count; ii += 2)
+            {
+                acc = _mm_add_pd(acc, _mm_mul_pd(_mm_loadu_pd(left + ii), _mm_loadu_pd(right + ii)));
+            }
+
+            double lanes[2];
+            _mm_storeu_pd(lanes, acc);
+            return lanes[0] + lanes[1] + dotDoubleScalar(left + ii, right + ii, count - ii);
+        }
+
+        static double minDoubleSSE2(const double* values, size_t count)
+        {
+            if (count < 2)
+            {
+                return minDoubleScalar(values, count);
+            }
+
+            __m128d acc = _mm_loadu_pd(values);
+            size_t ii = 2;
+            for (; ii + 2 <= count; ii += 2)
+            {
+                acc = _mm_min_pd(acc, _mm_loadu_pd(values + ii));
+            }
+
+            double lanes[2];
+            _mm_storeu_pd(lanes, acc);
+            double result = lanes[1] < lanes[0] ? lanes[1] : lanes[0];
+            return ii < count ? std::min(result, minDoubleScalar(values + ii, count - ii)) : result;
+        }
+
+        static double maxDoubleSSE2(const double* values, size_t count)
+        {
+            if (count < 2)
+            {
+                return maxDoubleScalar(values, count);
+            }
+
+            __m128d acc = _mm_loadu_pd(values);
+            size_t ii = 2;
+            for (; ii + 2 <= count; ii += 2)
+            {
+                acc = _mm_max_pd(acc, _mm_loadu_pd(values + ii));
+            }
+
+            double lanes[2];
+            _mm_storeu_pd(lanes, acc);
+            double result = lanes[1] > lanes[0] ? lanes[1] : lanes[0];
+            return ii < count ? std::max(result, maxDoubleScalar(values + ii, count - ii)) : result;
+        }
+
+        static void affineDoubleSSE2(const double* values, double scale, double offset, double* out, size_t count)
+        {
+            __m128d s = _mm_set1_pd(scale);
+            __m128d o = _mm_set1_pd(offset);
+            size_t ii = 0;
+            for (; ii + 2 <= count; ii += 2)
+            {
+                _mm_storeu_pd(out + ii, _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(values + ii), s), o));
+            }
+            affineDoubleScalar(values + ii, scale, offset, out + ii, count - ii);
+        }
+
+        // AVX2, four lanes
+
+        THROF_TARGET_AVX2
+        static void addInt64AVX2(const int64_t* left, const int64_t* right, int64_t* out, size_t count)
+        {
+            size_t ii = 0;
+            for (; ii + 4 <= count; ii += 4)
+            {
+                __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + ii));
+                __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right + ii));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + ii), _mm256_add_epi64(l, r));
+            }
+            addInt64Scalar(left + ii, right + ii, out + ii, count - ii);
+        }
+
+        THROF_TARGET_AVX2
+        static int64_t sumInt64AVX2(const int64_t* values, size_t count)
+        {
+            __m256i acc = _mm256_setzero_si256();
+            size_t ii = 0;
+            for (; ii + 4 <= count; ii += 4)
+            {
+                acc = _mm256_add_epi64(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + ii)));
+            }
+
+            int64_t lanes[4];
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+            int64_t sum = wrappingAdd(wrappingAdd(lanes[0], lanes[1]), wrappingAdd(lanes[2], lanes[3]));
+            return wrappingAdd(sum, sumInt64Scalar(values + ii, count - ii));
+        }
+
+        THROF_TARGET_AVX2
+        static int64_t minInt64AVX2(const int64_t* values, size_t count)
+        {
+            if (count < 4)
+            {
+                return minInt64Scalar(values, count);
+            }
+
+            __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values));
+            size_t ii = 4;
+            for (; ii + 4 <= count; ii += 4)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + ii));
+                acc = _mm256_blendv_epi8(acc, v, _mm256_cmpgt_epi64(acc, v));
+            }
+
+            int64_t lanes[4];
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+            int64_t result = minInt64Scalar(lanes, 4);
+            return ii < count ? std::min(result, minInt64Scalar(values + ii, count - ii)) : result;
+        }
+
+        THROF_TARGET_AVX2
+        static int64_t maxInt64AVX2(const int64_t* values, size_t count)
+        {
+            if (count < 4)
+            {
+                return maxInt64Scalar(values, count);
+            }
+
+            __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values));
+            size_t ii = 4;
+            for (; ii + 4 <= count; ii += 4)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + ii));
+                acc = _mm256_blendv_epi8(acc, v, _mm256_cmpgt_epi64(v, acc));
+            }
+
+            int64_t lanes[4];
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+            int64_t result = maxInt64Scalar(lanes, 4);
+            return ii < count ? std::max(result, maxInt64Scalar(values + ii, count - ii)) : result;
+        }
+
+        THROF_TARGET_AVX2
+        static void addDoubleAVX2(const double* left, const double* right, double* out, size_t count)
+        {
+            size_t ii = 0;
+            for (; ii + 4 <= count; ii += 4)
+            {
+                _mm256_storeu_pd(out + ii, _mm256_add_pd(_mm256_loadu_pd(left + ii), _mm256_loadu_pd(right + ii)));
+            }
+            addDoubleScalar(left + ii, right + ii, out + ii, count - ii);
+        }
+
+        THROF_TARGET_AVX2
+        static void mulDoubleAVX2(const double* left, const double* right, double* out, size_t count)
+        {
+            size_t ii = 0;
+            for (; ii + 4 <= count; ii += 4)
+            {
+                _mm256_storeu_pd(out + ii, _mm256_mul_pd(_mm256_loadu_pd(left + ii), _mm256_loadu_pd(right + ii)));
+            }
+            mulDoubleScalar(left + ii, right + ii, out + ii, count - ii);
+        }
+
+        THROF_TARGET_AVX2
+        static double sumDoubleAVX2(const double* values, size_t count)
+        {
+            __m256d acc = _mm256_setzero_pd();
+            size_t ii = 0;
+            for (; ii + 4 <= count; ii += 4)
+            {
+                acc = _mm256_add_pd(acc, _mm256_loadu_pd(values + ii));
+            }
+
+            double lanes[4];
+            _mm256_storeu_pd(lanes, acc);
+            return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + sumDoubleScalar(values + ii, count - ii);
+        }
+
+        THROF_TARGET_AVX2
+        static double dotDoubleAVX2(const double* left, const double* right, size_t count)
+        {
+            __m256d acc = _mm256_setzero_pd();
+            size_t ii = 0;
+            for (; ii + 4 <= count; ii += 4)
+            {
+                acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(left + ii), _mm256_loadu_pd(right + ii)));
+            }
+
+            double lanes[4];
+            _mm256_storeu_pd(lanes, acc);
+            return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + dotDoubleScalar(left + ii, right + ii, count - ii);
+        }
+
+        THROF_TARGET_AVX2
+        static double minDoubleAVX2(const double* values, size_t count)
+        {
+            if (count < 4)
+            {
+                return minDoubleScalar(values, count);
+            }
+
+            __m256d acc = _mm256_loadu_pd(values);
+            size_t ii = 4;
+            for (; ii + 4 <= count; ii += 4)
+            {
+                acc = _mm256_min_pd(acc, _mm256_loadu_pd(values + ii));
+            }
+
+            double lanes[4];
+            _mm256_storeu_pd(lanes, acc);
+            double result = minDoubleScalar(lanes, 4);
+            return ii < count ? std::min(result, minDoubleScalar(values + ii, count - ii)) : result;
+        }
+
+        THROF_TARGET_AVX2
+        static double maxDoubleAVX2(const double* values, size_t count)
+        {
+            if (count < 4)
+            {
+                return maxDoubleScalar(values, count);
+            }
+
+            __m256d acc = _mm256_loadu_pd(values);
+            size_t ii = 4;
+            for (; ii + 4 <= count; ii += 4)
+            {
+                acc = _mm256_max_pd(acc, _mm256_loadu_pd(values + ii));
+            }
+
+            double lanes[4];
+            _mm256_storeu_pd(lanes, acc);
+            double result = maxDoubleScalar(lanes, 4);
+            return ii < count ? std::max(result, maxDoubleScalar(values + ii, count - ii)) : result;
+        }
+
+        THROF_TARGET_AVX2
+        static void affineDoubleAVX2(const double* values, double scale, double offset, double* out, size_t count)
+        {
+            __m256d s = _mm256_set1_pd(scale);
+            __m256d o = _mm256_set1_pd(offset);
+            size_t ii = 0;
+            for (; ii + 4 <= count; ii += 4)
+            {
+                _mm256_storeu_pd(out + ii, _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(values + ii), s), o));
+            }
+            affineDoubleScalar(values + ii, scale, offset, out + ii, count - ii);
+        }
+#endif
+
+        struct Kernels
+        {
+            Level level;
+            void (*addInt64)(const int64_t*, const int64_t*, int64_t*, size_t);
+            void (*mulInt64)(const int64_t*, const int64_t*, int64_t*, size_t);
+            int64_t (*sumInt64)(const int64_t*, size_t);
+            int64_t (*dotInt64)(const int64_t*, const int64_t*, size_t);
+            int64_t (*minInt64)(const int64_t*, size_t);
+            int64_t (*maxInt64)(const int64_t*, size_t);
+            void (*affineInt64)(const int64_t*, int64_t, int64_t, int64_t*, size_t);
+            void (*addDouble)(const double*, const double*, double*, size_t);
+            void (*mulDouble)(const double*, const double*, double*, size_t);
+            double (*sumDouble)(const double*, size_t);
+            double (*dotDouble)(const double*, const double*, size_t);
+            double (*minDouble)(const double*, size_t);
+            double (*maxDouble)(const double*, size_t);
+            void (*affineDouble)(const double*, double, double, double*, size_t);
+        };
+
+#ifdef THROF_HAS_X86_SIMD
+        static Level detectLevel()
+        {
+            Level detected = Scalar;
+#ifdef _MSC_VER
+            int info[4];
+            __cpuid(info, 0);
+            int maxLeaf = info[0];
+            __cpuid(info, 1);
+            bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+            detected = (info[3] & (1 << 26)) ? SSE2 : Scalar;
+            if (maxLeaf >= 7 && osSavesYmm)
+            {
+                __cpuidex(info, 7, 0);
+                detected = (info[1] & (1 << 5)) ? AVX2 : detected;
+            }
+#else
+            __builtin_cpu_init();
+            detected = __builtin_cpu_supports("avx2") ? AVX2 : (__builtin_cpu_supports("sse2") ? SSE2 : Scalar);
+#endif
+
+            const char* cap = getenv("THROF_SIMD");
+            if (nullptr != cap)
+            {
+                Level capped = 0 == strcmp(cap, "scalar") ? Scalar : (0 == strcmp(cap, "sse2") ? SSE2 : AVX2);
+                detected = std::min(detected, capped);
+            }
+            return detected;
+        }
+#endif
+
+        static Kernels selectKernels()
+        {
+            Kernels k = { Scalar,
+                addInt64Scalar, mulInt64Scalar, sumInt64Scalar, dotInt64Scalar, minInt64Scalar, maxInt64Scalar, affineInt64Scalar,
+                addDoubleScalar, mulDoubleScalar, sumDoubleScalar, dotDoubleScalar, minDoubleScalar, maxDoubleScalar, affineDoubleScalar };
+
+#ifdef THROF_HAS_X86_SIMD
+            Level detected = detectLevel();
+            if (detected >= SSE2)
+            {
+                k.level = SSE2;
+                k.addInt64 = addInt64SSE2;
+                k.sumInt64 = sumInt64SSE2;
+                k.addDouble = addDoubleSSE2;
+                k.mulDouble = mulDoubleSSE2;
+                k.sumDouble = sumDoubleSSE2;
+                k.dotDouble = dotDoubleSSE2;
+                k.minDouble = minDoubleSSE2;
+                k.maxDouble = maxDoubleSSE2;
+                k.affineDouble = affineDoubleSSE2;
+            }
+            if (detected >= AVX2)
+            {
+                k.level = AVX2;
+                k.addInt64 = addInt64AVX2;
+                k.sumInt64 = sumInt64AVX2;
+                k.minInt64 = minInt64AVX2;
+                k.maxInt64 = maxInt64AVX2;
+                k.addDouble = addDoubleAVX2;
+                k.mulDouble = mulDoubleAVX2;
+                k.sumDouble = sumDoubleAVX2;
+                k.dotDouble = dotDoubleAVX2;
+                k.minDouble = minDoubleAVX2;
+                k.maxDouble = maxDoubleAVX2;
+                k.affineDouble = affineDoubleAVX2;
+            }
+#endif
+            return k;
+        }
+
+        static const Kernels& kernels()
+        {
+            static const Kernels s_kernels = selectKernels();
+            return s_kernels;
+        }
+
+        Level level()
+        {
+            return kernels().level;
+        }
+
+        const char* levelName(Level level)
+        {
+            switch (level)
+            {
+            case AVX2:
+                return "AVX2";
+            case SSE2:
+                return "SSE2";
+            default:
+                return "scalar";
+            }
+        }
+
+        void addInt64(const int64_t* left, const int64_t* right, int64_t* out, size_t count)
+        {
+            kernels().addInt64(left, right, out, count);
+        }
+
+        void mulInt64(const int64_t* left, const int64_t* right, int64_t* out, size_t count)
+        {
+            kernels().mulInt64(left, right, out, count);
+        }
+
+        int64_t sumInt64(const int64_t* values, size_t count)
+        {
+            return kernels().sumInt64(values, count);
+        }
+
+        int64_t dotInt64(const int64_t* left, const int64_t* right, size_t count)
+        {
+            return kernels().dotInt64(left, right, count);
+        }
+
+        int64_t minInt64(const int64_t* values, size_t count)
+        {
+            return kernels().minInt64(values, count);
+        }
+
+        int64_t maxInt64(const int64_t* values, size_t count)
+        {
+            return kernels().maxInt64(values, count);
+        }
+
+        void affineInt64(const int64_t* values, int64_t scale, int64_t offset, int64_t* out, size_t count)
+        {
+            kernels().affineInt64(values, scale, offset, out, count);
+        }
+
+        void addDouble(const double* left, const double* right, double* out, size_t count)
+        {
+            kernels().addDouble(left, right, out, count);
+        }
+
+        void mulDouble(const double* left, const double* right, double* out, size_t count)
+        {
+            kernels().mulDouble(left, right, out, count);
+        }
+
+        double sumDouble(const double* values, size_t count)
+        {
+            return kernels().sumDouble(values, count);
+        }
+
+        double dotDouble(const double* left, const double* right, size_t count)
+        {
+            return kernels().dotDouble(left, right, count);
+        }
+
+        double minDouble(const double* values, size_t count)
+        {
+            return kernels().minDouble(values, count);
+        }
+
+        double maxDouble(const double* values, size_t count)
+        {
+            return kernels().maxDouble(values, count);
+        }
+
+        void affineDouble(const double* values, double scale, double offset, double* out, size_t count)
+        {
+            kernels().affineDouble(values, scale, offset, out, count);
+        }
+    }
+}
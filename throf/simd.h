@@ -0,0 +1,51 @@
+#pragma once
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#define THROF_HAS_X86_SIMD 1
+#elif defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#include <immintrin.h>
+#define THROF_HAS_X86_SIMD 1
+#endif
+
+namespace throf
+{
+    // Bulk kernels behind the array words. Every kernel has a scalar version and, on
+    // x86, SSE2 and AVX2 versions; the best level the CPU supports is picked the first
+    // time a kernel runs. THROF_SIMD=scalar|sse2|avx2 in the environment caps the level,
+    // which is how the fallbacks get exercised on a machine that has AVX2.
+    //
+    // Neither SSE2 nor AVX2 has a packed 64-bit integer multiply, so the integer
+    // multiply, dot product and affine kernels are scalar at every level, as are the
+    // integer min/max at SSE2 (the 64-bit compare arrived with SSE4.2). Integer
+    // arithmetic wraps around on overflow.
+    namespace simd
+    {
+        enum Level
+        {
+            Scalar,
+            SSE2,
+            AVX2
+        };
+
+        Level level();
+        const char* levelName(Level level);
+
+        void addInt64(const int64_t* left, const int64_t* right, int64_t* out, size_t count);
+        void mulInt64(const int64_t* left, const int64_t* right, int64_t* out, size_t count);
+        int64_t sumInt64(const int64_t* values, size_t count);
+        int64_t dotInt64(const int64_t* left, const int64_t* right, size_t count);
+        int64_t minInt64(const int64_t* values, size_t count);
+        int64_t maxInt64(const int64_t* values, size_t count);
+        void affineInt64(const int64_t* values, int64_t scale, int64_t offset, int64_t* out, size_t count);
+
+        void addDouble(const double* left, const double* right, double* out, size_t count);
+        void mulDouble(const double* left, const double* right, double* out, size_t count);
+        double sumDouble(const double* values, size_t count);
+        double dotDouble(const double* left, const double* right, size_t count);
+        double minDouble(const double* values, size_t count);
+        double maxDouble(const double* values, size_t count);
+        void affineDouble(const double* values, double scale, double offset, double* out, size_t count);
+    }
+}
@@ -2,65 +2,168 @@
 
 namespace throf
 {
+    StackElement::AllocationStats StackElement::s_allocationStats = { 0, 0, 0, 0 };
+
+    static const size_t SMALL_STRING_CAPACITY = std::string().capacity();
+
+    int StringView::compare(const StringView& other) const
+    {
+        int ret = memcmp(data, other.data, min(size, other.size));
+        if (ret != 0)
+        {
+            return ret;
+        }
+        return (size < other.size) ? -1 : ((size > other.size) ? 1 : 0);
+    }
+
+    std::ostream& operator<<(std::ostream& stream, const StringView& view)
+    {
+        return stream.write(view.data, view.size);
+    }
+
+    const StackElement::AllocationStats& StackElement::allocationStats()
+    {
+        return s_allocationStats;
+    }
+
+    void StackElement::countString() const
+    {
+        if (_string->size() > SMALL_STRING_CAPACITY)
+        {
+            s_allocationStats.stringAllocations++;
+            s_allocationStats.stringBytes += _string->capacity() + 1;
+        }
+    }
+
+    void StackElement::countAllocations() const
+    {
+        if (!_dataQuotation.empty())
+        {
+            s_allocationStats.quotationAllocations++;
+            s_allocationStats.quotationBytes += _dataQuotation.capacity() * sizeof(StackElement);
+        }
+    }
+
     StackElement::StackElement() :
         _type(ElementType::Nil),
         _dataNumber(0xdeadbeef),
-        _dataString(""),
+        _dataDouble(0),
+        _atom(SymbolTable::EMPTY),
+        _view(),
         _dataBoolean(false),
         _dataWordRefCurrentOffset(-1),
-        _dataWordRefId(0xdeadbeef),
-        _wordName("")
+        _dataWordRefId(0xdeadbeef)
     { }
 
-    StackElement::StackElement(const StackElement::ElementType type, long val) :
+    StackElement::StackElement(const StackElement::ElementType type, int64_t val) :
         _type(type),
         _dataNumber(val),
-        _dataString(""),
+        _dataDouble(0),
+        _atom(SymbolTable::EMPTY),
+        _view(),
         _dataBoolean(val != 0),
         _dataWordRefCurrentOffset(-1),
+        _dataWordRefId(0xdeadbeef)
+    { }
+
+    StackElement::StackElement(const StackElement::ElementType type, const string& val) :
+        _type(type),
+        _dataNumber(0xdeadbeef),
+        _dataDouble(0),
+        _atom(SymbolTable::EMPTY),
+        _view(),
+        _dataBoolean(!val.empty()),
+        _dataWordRefCurrentOffset(-1),
+        _dataWordRefId(0xdeadbeef)
+    {
+        setString(allocate_shared<ValueString>(ResourceAllocator<ValueString>(), val.data(), val.size()));
+        countString();
+    }
+
+    StackElement::StackElement(const StackElement::ElementType type, const char* data, size_t length) :
+        _type(type),
+        _dataNumber(0xdeadbeef),
+        _dataDouble(0),
+        _atom(SymbolTable::EMPTY),
+        _view(),
+        _dataBoolean(length != 0),
+        _dataWordRefCurrentOffset(-1),
+        _dataWordRefId(0xdeadbeef)
+    {
+        setString(allocate_shared<ValueString>(ResourceAllocator<ValueString>(), data, length));
+        countString();
+    }
+
+    StackElement::StackElement(const StackElement::ElementType type, CodeVector val) :
+        _type(type),
+        _dataNumber(0xdeadbeef),
+        _dataDouble(0),
+        _atom(SymbolTable::EMPTY),
+        _view(),
+        _dataBoolean(val.size() != 0),
+        _dataWordRefCurrentOffset(-1),
         _dataWordRefId(0xdeadbeef),
-        _wordName("")
+        _dataQuotation(std::move(val))
+    {
+        countAllocations();
+    }
+
+    StackElement::StackElement(const StackElement::ElementType type, BooleanType val) :
+        _type(type),
+        _dataNumber(0xdeadbeef),
+        _dataDouble(0),
+        _atom(SymbolTable::EMPTY),
+        _view(),
+        _dataBoolean(val), 
+        _dataWordRefCurrentOffset(-1),
+        _dataWordRefId(0xdeadbeef)
     { }
 
-    StackElement::StackElement(const StackElement::ElementType type, string val) :
+    StackElement::StackElement(const StackElement::ElementType type, shared_ptr<const NumericArray> val) :
         _type(type),
         _dataNumber(0xdeadbeef),
-        _dataString(val),
-        _dataBoolean(val != ""),
+        _dataDouble(0),
+        _atom(SymbolTable::EMPTY),
+        _view(),
+        _dataBoolean(val->size() != 0),
         _dataWordRefCurrentOffset(-1),
         _dataWordRefId(0xdeadbeef),
-        _wordName("")
+        _array(std::move(val))
     { }
 
-    StackElement::StackElement(const StackElement::ElementType type, std::vector<StackElement> val) :
+    StackElement::StackElement(const StackElement::ElementType type, shared_ptr<HashMap> val) :
         _type(type),
         _dataNumber(0xdeadbeef),
-        _dataString(""),
-        _dataBoolean(val.size() != 0),
+        _dataDouble(0),
+        _atom(SymbolTable::EMPTY),
+        _view(),
+        _dataBoolean(true),
         _dataWordRefCurrentOffset(-1),
         _dataWordRefId(0xdeadbeef),
-        _dataQuotation(val),
-        _wordName("")
+        _map(std::move(val))
     { }
 
-    StackElement::StackElement(const StackElement::ElementType type, BooleanType val) :
+    StackElement::StackElement(const StackElement::ElementType type, shared_ptr<TupleValue> val) :
         _type(type),
         _dataNumber(0xdeadbeef),
-        _dataString(""),
-        _dataBoolean(val), 
+        _dataDouble(0),
+        _atom(SymbolTable::EMPTY),
+        _view(),
+        _dataBoolean(true),
         _dataWordRefCurrentOffset(-1),
         _dataWordRefId(0xdeadbeef),
-        _wordName("")
+        _tuple(std::move(val))
     { }
 
     StackElement::StackElement(const ElementType type, const string wordName, WORD_ID wordIdx, int definitionIndex) :
         _type(type),
         _dataNumber(0xdeadbeef),
-        _dataString(""),
+        _dataDouble(0),
+        _atom(SymbolTable::intern(wordName)),
+        _view(),
         _dataBoolean(true),
         _dataWordRefCurrentOffset(definitionIndex),
-        _dataWordRefId(wordIdx),
-        _wordName(wordName)
+        _dataWordRefId(wordIdx)
     { }
 
     StackElement::StackElement(const StackElement& other)
@@ -71,31 +174,412 @@ namespace throf
     StackElement& StackElement::operator=(const StackElement& other)
     {
         this->_dataNumber = other._dataNumber;
-        this->_dataString = other._dataString;
-        this->_dataQuotation = other._dataQuotation;
+        this->_dataDouble = other._dataDouble;
+
+        this->_atom = other._atom;
+        this->_string = other._string;
+        this->_rope = other._rope;
+        this->_view = other._view;
+
+        // most elements are numbers and word references without a body; an empty assign
+        // still costs a round through the allocator aware container code
+        if (!this->_dataQuotation.empty() || !other._dataQuotation.empty())
+        {
+            this->_dataQuotation = other._dataQuotation;
+        }
+        this->_closure = other._closure;
+        this->_array = other._array;
+        this->_map = other._map;
+        this->_tuple = other._tuple;
+        if (this->_bigInteger || other._bigInteger)
+        {
+            this->_bigInteger = other._bigInteger ? allocate_shared<BigInteger>(ResourceAllocator<BigInteger>(), *other._bigInteger) : nullptr;
+        }
+        this->_dataBoolean = other._dataBoolean;
+        this->_dataWordRefCurrentOffset = other._dataWordRefCurrentOffset;
+        this->_dataWordRefId = other._dataWordRefId;
+        this->_type = other._type;
+        countAllocations();
+        return *this;
+    }
+
+    StackElement::StackElement(StackElement&& other) THROF_NOEXCEPT
+    {
+        *this = std::move(other);
+    }
+
+    StackElement& StackElement::operator=(StackElement&& other) THROF_NOEXCEPT
+    {
+        this->_dataNumber = other._dataNumber;
+        this->_dataDouble = other._dataDouble;
+        this->_atom = other._atom;
+        this->_string.swap(other._string);
+        this->_rope.swap(other._rope);
+        this->_view = other._view;
+        this->_dataQuotation.swap(other._dataQuotation);
+        this->_closure.swap(other._closure);
+        this->_array.swap(other._array);
+        this->_map.swap(other._map);
+        this->_tuple.swap(other._tuple);
+        this->_bigInteger.swap(other._bigInteger);
         this->_dataBoolean = other._dataBoolean;
         this->_dataWordRefCurrentOffset = other._dataWordRefCurrentOffset;
         this->_dataWordRefId = other._dataWordRefId;
-        this->_wordName = other._wordName;
         this->_type = other._type;
         return *this;
     }
 
-    const string& StackElement::stringData() const
+    void StackElement::placeIn(MemoryResource* resource)
     {
-        return _dataString;
+        if (_string || _rope)
+        {
+            StringView view = stringData();
+            setString(allocate_shared<ValueString>(ResourceAllocator<ValueString>(resource), view.data, view.size, ResourceAllocator<char>(resource)));
+        }
+
+        // empty bodies are rebuilt as well, so that values later assigned into this
+        // element (variables) are allocated from resource too
+        placeCode(_dataQuotation, resource);
+
+        if (_array)
+        {
+            auto placed = allocate_shared<NumericArray>(ResourceAllocator<NumericArray>(resource), _array->kind, ResourceAllocator<char>(resource));
+            placed->ints.assign(_array->ints.begin(), _array->ints.end());
+            placed->doubles.assign(_array->doubles.begin(), _array->doubles.end());
+            _array = std::move(placed);
+        }
+
+        if (_bigInteger)
+        {
+            _bigInteger = allocate_shared<BigInteger>(ResourceAllocator<BigInteger>(resource), *_bigInteger, ResourceAllocator<uint32_t>(resource));
+        }
     }
 
-    const long& StackElement::numberData() const
+    // static
+    void StackElement::placeCode(CodeVector& code, MemoryResource* resource)
+    {
+        CodeVector placed((ResourceAllocator<StackElement>(resource)));
+        placed.reserve(code.size());
+        for (auto itr = code.begin(); itr != code.end(); itr++)
+        {
+            placed.push_back(std::move(*itr));
+            placed.back().placeIn(resource);
+        }
+        code.swap(placed);
+    }
+
+    StringView StackElement::stringData() const
+    {
+        if (_rope)
+        {
+            const ValueString& flat = _rope->flatten();
+            StringView ret = { flat.data(), flat.size() };
+            return ret;
+        }
+        if (nullptr != _view.data)
+        {
+            return _view;
+        }
+
+        const ValueString& name = SymbolTable::name(_atom);
+        StringView ret = { name.data(), name.size() };
+        return ret;
+    }
+
+    size_t StackElement::stringLength() const
+    {
+        if (_rope)
+        {
+            return _rope->length;
+        }
+        return (nullptr != _view.data) ? _view.size : SymbolTable::name(_atom).size();
+    }
+
+    bool StackElement::interned() const
+    {
+        return !_rope && nullptr == _view.data;
+    }
+
+    void StackElement::setString(shared_ptr<const ValueString> buffer)
+    {
+        _string = std::move(buffer);
+        _rope = nullptr;
+        _view.data = _string->data();
+        _view.size = _string->size();
+    }
+
+    SymbolTable::Atom StackElement::atom() const
+    {
+        return _atom;
+    }
+
+    const int64_t& StackElement::numberData() const
     {
         return _dataNumber;
     }
 
-    const vector<StackElement>& StackElement::quotationData() const
+    double StackElement::doubleData() const
+    {
+        return _dataDouble;
+    }
+
+    const BigInteger* StackElement::bigIntegerData() const
+    {
+        return _bigInteger.get();
+    }
+
+    const CodeVector& StackElement::quotationData() const
     {
         return _dataQuotation;
     }
 
+    const StackElement::Closure* StackElement::closure() const
+    {
+        return _closure.get();
+    }
+
+    const NumericArray* StackElement::arrayData() const
+    {
+        return _array.get();
+    }
+
+    HashMap* StackElement::mapData() const
+    {
+        return _map.get();
+    }
+
+    TupleValue* StackElement::tupleData() const
+    {
+        return _tuple.get();
+    }
+
+    bool StackElement::ownsMemory() const
+    {
+        return _string || _rope || !_dataQuotation.empty() || _closure || _array || _bigInteger;
+    }
+
+    // static
+    shared_ptr<NumericArray> StackElement::makeArray(NumericArray::Kind kind, size_t count)
+    {
+        auto ret = allocate_shared<NumericArray>(ResourceAllocator<NumericArray>(), kind, ResourceAllocator<char>());
+        if (kind == NumericArray::Int64)
+        {
+            ret->ints.resize(count);
+        }
+        else
+        {
+            ret->doubles.resize(count);
+        }
+        return ret;
+    }
+
+    // static
+    StackElement StackElement::intern(const string& text)
+    {
+        StackElement ret(String, static_cast<int64_t>(0));
+        ret._atom = SymbolTable::intern(text);
+        ret._dataBoolean = !text.empty();
+        return ret;
+    }
+
+    // static
+    StackElement StackElement::makeBoundPrimitive(const string& name, WORD_ID primitive, size_t binding, int slot)
+    {
+        StackElement ret(WordReference, name, primitive, slot);
+        ret._dataNumber = static_cast<int64_t>(binding);
+        return ret;
+    }
+
+    StackElement StackElement::slice(size_t offset, size_t count) const
+    {
+        StringView view = stringData();
+
+        // a slice of an interned string points into the symbol table, which needs no owner
+        StackElement ret(String, static_cast<int64_t>(0));
+        ret._string = _rope ? _rope->flat : _string;
+        ret._view.data = view.data + offset;
+        ret._view.size = count;
+        ret._dataBoolean = count != 0;
+        return ret;
+    }
+
+    // static
+    StackElement StackElement::concat(const StackElement& left, const StackElement& right)
+    {
+        size_t length = left.stringLength() + right.stringLength();
+        if (length <= ROPE_LEAF_SIZE)
+        {
+            StringView first = left.stringData(), second = right.stringData();
+            auto buffer = allocate_shared<ValueString>(ResourceAllocator<ValueString>());
+            buffer->reserve(length);
+            buffer->append(first.data, first.size).append(second.data, second.size);
+
+            StackElement ret(String, static_cast<int64_t>(0));
+            ret.setString(std::move(buffer));
+            ret._dataBoolean = length != 0;
+            ret.countString();
+            return ret;
+        }
+
+        // a loop appending short strings would otherwise add a level for every one
+        const Rope* rope = left._rope.get();
+        if (nullptr != rope && !rope->flat && !rope->right._rope && right.stringLength() < ROPE_LEAF_SIZE &&
+            rope->right.stringLength() + right.stringLength() <= ROPE_LEAF_SIZE)
+        {
+            return makeRope(rope->left, concat(rope->right, right));
+        }
+
+        return makeRope(left, right);
+    }
+
+    // static
+    StackElement StackElement::makeRope(StackElement left, StackElement right)
+    {
+        unsigned depth = 1 + max(left._rope ? left._rope->depth : 0, right._rope ? right._rope->depth : 0);
+
+        StackElement ret(String, static_cast<int64_t>(0));
+        ret._rope = allocate_shared<Rope>(ResourceAllocator<Rope>(), std::move(left), std::move(right), depth, ResourceAllocator<char>());
+        ret._dataBoolean = ret._rope->length != 0;
+        if (depth > MAX_ROPE_DEPTH)
+        {
+            ret._rope->flatten();
+            ret.setString(ret._rope->flat);
+        }
+        return ret;
+    }
+
+    // static
+    void StackElement::appendFlat(ValueString& buffer, const StackElement& piece)
+    {
+        if (piece._rope && !piece._rope->flat)
+        {
+            appendFlat(buffer, piece._rope->left);
+            appendFlat(buffer, piece._rope->right);
+            return;
+        }
+
+        StringView view = piece.stringData();
+        buffer.append(view.data, view.size);
+    }
+
+    const ValueString& StackElement::Rope::flatten() const
+    {
+        if (!flat)
+        {
+            ValueString buffer(allocator);
+            buffer.reserve(length);
+            appendFlat(buffer, left);
+            appendFlat(buffer, right);
+            flat = allocate_shared<ValueString>(ResourceAllocator<ValueString>(allocator), std::move(buffer));
+
+            if (flat->size() > SMALL_STRING_CAPACITY)
+            {
+                s_allocationStats.stringAllocations++;
+                s_allocationStats.stringBytes += flat->capacity() + 1;
+            }
+
+            // the pieces are not needed any more
+            left = StackElement();
+            right = StackElement();
+        }
+        return *flat;
+    }
+
+    // static
+    StackElement StackElement::makeVariable(const string& name, WORD_ID id)
+    {
+        StackElement ret(Variable, static_cast<int64_t>(0));
+        ret._atom = SymbolTable::intern(name);
+        ret._dataBoolean = !name.empty();
+        ret._dataWordRefId = id;
+        return ret;
+    }
+
+    // static
+    StackElement StackElement::makeDouble(double value)
+    {
+        StackElement ret(Double, static_cast<int64_t>(0));
+        ret._dataDouble = value;
+        ret._dataBoolean = value != 0;
+        return ret;
+    }
+
+    // static
+    StackElement StackElement::makeBigInteger(const BigInteger& value)
+    {
+        StackElement ret(BigNumber, static_cast<int64_t>(0));
+        ret._bigInteger = allocate_shared<BigInteger>(ResourceAllocator<BigInteger>(), value);
+        ret._dataBoolean = true;
+        return ret;
+    }
+
+    // static
+    StackElement StackElement::curry(StackElement value, StackElement quotation)
+    {
+        StackElement ret(Quotation, CodeVector());
+        ret._dataBoolean = true;
+        ret._closure = std::allocate_shared<Closure>(ResourceAllocator<Closure>(), Closure::Curry, std::move(value), std::move(quotation));
+        return ret;
+    }
+
+    // static
+    StackElement StackElement::compose(StackElement first, StackElement second)
+    {
+        StackElement ret(Quotation, CodeVector());
+        ret._dataBoolean = true;
+        ret._closure = std::allocate_shared<Closure>(ResourceAllocator<Closure>(), Closure::Compose, std::move(first), std::move(second));
+        return ret;
+    }
+
+    CodeVector StackElement::flattenQuotation() const
+    {
+        if (!_closure)
+        {
+            return _dataQuotation;
+        }
+
+        CodeVector body;
+        if (_closure->kind == Closure::Curry)
+        {
+            body.push_back(_closure->first);
+        }
+        else
+        {
+            CodeVector first = _closure->first.flattenQuotation();
+            body.insert(body.end(), first.begin(), first.end());
+        }
+
+        CodeVector second = _closure->second.flattenQuotation();
+        body.insert(body.end(), second.begin(), second.end());
+        return body;
+    }
+
+    void StackElement::unshare()
+    {
+        if (_string || _rope)
+        {
+            StringView view = stringData();
+            setString(allocate_shared<ValueString>(ResourceAllocator<ValueString>(), view.data, view.size));
+        }
+
+        if (_closure)
+        {
+            StackElement first(_closure->first);
+            StackElement second(_closure->second);
+            first.unshare();
+            second.unshare();
+            _closure = std::allocate_shared<Closure>(ResourceAllocator<Closure>(), _closure->kind, std::move(first), std::move(second));
+        }
+
+        if (_array)
+        {
+            auto copy = makeArray(_array->kind, 0);
+            copy->ints.assign(_array->ints.begin(), _array->ints.end());
+            copy->doubles.assign(_array->doubles.begin(), _array->doubles.end());
+            _array = std::move(copy);
+        }
+    }
+
     StackElement::BooleanType StackElement::booleanData() const
     {
         return _dataBoolean;
@@ -125,11 +609,11 @@ namespace throf
         throw ThrofException("StackElement", strBuilder.str());
     }
 
-    const string& StackElement::wordName() const
+    const ValueString& StackElement::wordName() const
     {
         if (_type == WordReference)
         {
-            return _wordName;
+            return SymbolTable::name(_atom);
         }
 
         stringstream strBuilder;
@@ -137,6 +621,18 @@ namespace throf
         throw ThrofException("StackElement", strBuilder.str());
     }
 
+    const WORD_ID StackElement::variableId() const
+    {
+        if (_type == Variable)
+        {
+            return _dataWordRefId;
+        }
+
+        stringstream strBuilder;
+        strBuilder << "StackElement is not of type Variable, type = " << _type << ".";
+        throw ThrofException("StackElement", strBuilder.str());
+    }
+
     const StackElement::ElementType StackElement::type() const
     {
         return _type;
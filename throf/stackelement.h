@@ -2,6 +2,53 @@
 
 namespace throf
 {
+    class StackElement;
+    class HashMap;
+    struct TupleValue;
+
+    // compiled code and quotation bodies; see ResourceAllocator for where they live
+    typedef std::vector<StackElement, ResourceAllocator<StackElement>> CodeVector;
+
+    // packed numeric array payloads, allocated the same way
+    typedef std::vector<int64_t, ResourceAllocator<int64_t>> Int64Vector;
+    typedef std::vector<double, ResourceAllocator<double>> DoubleVector;
+
+    // A packed array of int64s or doubles, the operand of the bulk array words. Arrays are
+    // immutable once built: words that transform one make a new one, and copying an
+    // Array element only copies the pointer.
+    struct NumericArray
+    {
+        enum Kind
+        {
+            Int64,
+            Double
+        };
+
+        Kind kind;
+        Int64Vector ints;
+        DoubleVector doubles;
+
+        NumericArray(Kind k, const ResourceAllocator<char>& allocator) : kind(k), ints(allocator), doubles(allocator) { }
+
+        size_t size() const { return kind == Int64 ? ints.size() : doubles.size(); }
+
+        // element ii as a double, whatever the kind
+        double at(size_t ii) const { return kind == Int64 ? static_cast<double>(ints[ii]) : doubles[ii]; }
+    };
+
+    // The bytes of a String, valid for as long as the element they came from. Slices and
+    // ropes have no ValueString of their own to hand out.
+    struct StringView
+    {
+        const char* data;
+        size_t size;
+
+        std::string str() const { return std::string(data, size); }
+        int compare(const StringView& other) const;
+    };
+
+    std::ostream& operator<<(std::ostream& stream, const StringView& view);
+
     class StackElement
     {
     public:
@@ -13,7 +60,12 @@ namespace throf
             Number,
             Boolean,
             WordReference,
-            Quotation
+            Quotation,
+            Array,
+            Double,
+            BigNumber,
+            Map,
+            Tuple
         };
 
         struct BooleanType
@@ -28,22 +80,104 @@ namespace throf
             std::string toString() { return (value ? "true" : "false"); }
         };
 
+        // Heap usage attributable to string and quotation payloads, across all
+        // interpreters in the process. Strings are counted when built at runtime, copies
+        // of them being shared; interned strings and strings short enough for the small
+        // string buffer aren't counted.
+        struct AllocationStats
+        {
+            unsigned long long stringAllocations;
+            unsigned long long stringBytes;
+            unsigned long long quotationAllocations;
+            unsigned long long quotationBytes;
+        };
+
+        static const AllocationStats& allocationStats();
+
+        // A quotation built by curry or compose. It holds on to the values it was made
+        // from rather than splicing copies of them into a new body, and copying the
+        // quotation only copies the pointer.
+        struct Closure;
+
+        // A String made by concat. The pieces are kept as they are until the bytes are
+        // first needed, and are then copied once into a buffer the rope holds on to.
+        struct Rope;
+
+        // concatenations shorter than this are copied right away, and a short piece
+        // appended to a rope is merged into its last piece when that one is short too
+        static const size_t ROPE_LEAF_SIZE = 256;
+
+        // a rope nested deeper than this is flattened on the spot, which keeps flattening
+        // and destroying ropes from recursing without bound
+        static const unsigned MAX_ROPE_DEPTH = 64;
+
     private:
+        static AllocationStats s_allocationStats;
+
+        void countString() const;
+        void setString(std::shared_ptr<const ValueString> buffer);
+
+        static StackElement makeRope(StackElement left, StackElement right);
+        static void appendFlat(ValueString& buffer, const StackElement& piece);
+        void countAllocations() const;
+
         ElementType _type;
-        long _dataNumber;
-        std::string _dataString;
+        int64_t _dataNumber;
+        double _dataDouble;
+        SymbolTable::Atom _atom;
+
+        // Runtime strings view bytes in _string, or in the symbol table for a slice of an
+        // interned string, which has no owner. Ropes have _rope instead.
+        std::shared_ptr<const ValueString> _string;
+        std::shared_ptr<const Rope> _rope;
+        StringView _view;
         BooleanType _dataBoolean;
         int _dataWordRefCurrentOffset;
         WORD_ID _dataWordRefId;
-        std::vector<StackElement> _dataQuotation;
-        std::string _wordName;
+        CodeVector _dataQuotation;
+        std::shared_ptr<const Closure> _closure;
+        std::shared_ptr<const NumericArray> _array;
+        std::shared_ptr<const BigInteger> _bigInteger;
+        std::shared_ptr<HashMap> _map;
+        std::shared_ptr<TupleValue> _tuple;
 
     public:
-        const std::string& stringData() const;
+        // The text of a String, or the name of a Variable. Flattens a rope.
+        StringView stringData() const;
+
+        // without flattening
+        size_t stringLength() const;
+
+        // Strings from the source are interned, strings built at runtime (slices and ropes
+        // included) are not; two interned strings are equal exactly when their atoms are.
+        bool interned() const;
+        SymbolTable::Atom atom() const;
+
+        const int64_t& numberData() const;
+
+        double doubleData() const;
+
+        // null unless this is a BigNumber
+        const BigInteger* bigIntegerData() const;
+
+        const CodeVector& quotationData() const;
+
+        // null unless this quotation came from curry or compose
+        const Closure* closure() const;
+
+        // null unless this is an Array
+        const NumericArray* arrayData() const;
+
+        // null unless this is a Map; maps are changed in place, through any copy
+        HashMap* mapData() const;
 
-        const long& numberData() const;
+        // null unless this is a Tuple; slots are changed in place, through any copy
+        TupleValue* tupleData() const;
 
-        const std::vector<StackElement>& quotationData() const;
+        // true if this element holds memory beyond itself: runtime strings, quotations,
+        // closures, arrays, big numbers. Not maps and tuples, which are long lived
+        // already and are shared, never copied.
+        bool ownsMemory() const;
 
         BooleanType booleanData() const;
 
@@ -51,24 +185,132 @@ namespace throf
 
         const WORD_ID wordRefId() const;
 
-        const std::string& wordName() const;
+        const ValueString& wordName() const;
+
+        // the dictionary entry of a Variable
+        const WORD_ID variableId() const;
 
         const ElementType type() const;
 
         StackElement();
 
-        explicit StackElement(const ElementType type, long val);
+        explicit StackElement(const ElementType type, int64_t val);
+
+        // a string built at runtime, copies and slices of which share one buffer
+        explicit StackElement(const ElementType type, const std::string& val);
 
-        explicit StackElement(const ElementType type, std::string val);
+        explicit StackElement(const ElementType type, const char* data, size_t length);
 
-        explicit StackElement(const ElementType type, std::vector<StackElement> val);
+        explicit StackElement(const ElementType type, CodeVector val);
 
         explicit StackElement(const ElementType type, BooleanType val);
 
+        explicit StackElement(const ElementType type, std::shared_ptr<const NumericArray> val);
+
+        explicit StackElement(const ElementType type, std::shared_ptr<HashMap> val);
+
+        explicit StackElement(const ElementType type, std::shared_ptr<TupleValue> val);
+
         explicit StackElement(const ElementType type, const std::string wordName, WORD_ID wordIdx, int definitionIndex);
 
         StackElement(const StackElement& other);
 
         StackElement& operator=(const StackElement& right);
+
+        // moves hand over the quotation buffer and the shared payloads, nothing is allocated
+        StackElement(StackElement&& other) THROF_NOEXCEPT;
+
+        StackElement& operator=(StackElement&& right) THROF_NOEXCEPT;
+
+        // an interned String, as for a literal in the source
+        static StackElement intern(const std::string& text);
+
+        // count bytes of this String from offset on, sharing its buffer; a rope is
+        // flattened first
+        StackElement slice(size_t offset, size_t count) const;
+
+        // left followed by right, as a rope unless it is short
+        static StackElement concat(const StackElement& left, const StackElement& right);
+
+        // Variable name, resolved to its dictionary entry when compiled
+        static StackElement makeVariable(const std::string& name, WORD_ID id);
+
+        // A reference to a primitive that carries what it was compiled for: the tuple
+        // class and slot of a word :tuple declares, or the frame and slot of a local.
+        static StackElement makeBoundPrimitive(const std::string& name, WORD_ID primitive, size_t binding, int slot);
+
+        // Double and BigNumber elements. A copy of a BigNumber gets a copy of its digits,
+        // allocated like a copied string.
+        static StackElement makeDouble(double value);
+        static StackElement makeBigInteger(const BigInteger& value);
+
+        // quotation that pushes value and then runs quotation
+        static StackElement curry(StackElement value, StackElement quotation);
+
+        // quotation that runs first and then second
+        static StackElement compose(StackElement first, StackElement second);
+
+        // array of count zeroed elements, allocated from the default resource, for the
+        // caller to fill in before handing it to an Array element
+        static std::shared_ptr<NumericArray> makeArray(NumericArray::Kind kind, size_t count);
+
+        // The code a quotation runs, closures spelled out as a plain body.
+        CodeVector flattenQuotation() const;
+
+        // Replaces shared strings, closures and arrays with copies of its own (ropes and
+        // slices copied flat), allocated from the
+        // default resource, for values that must not depend on memory they were built in.
+        void unshare();
+
+        // Moves the runtime string (flattened), quotation body or big number, and the bodies nested in it,
+        // into memory from resource.
+        void placeIn(MemoryResource* resource);
+
+        // The same for a whole piece of compiled code.
+        static void placeCode(CodeVector& code, MemoryResource* resource);
+    };
+
+    // A record declared with :tuple: the number of its class and its slot values, side
+    // by side in one vector. Like maps, tuples are shared by every copy of the element
+    // and live in the interpreter's long lived memory.
+    struct TupleValue
+    {
+        size_t classId;
+        CodeVector slots;
+
+        TupleValue(size_t id, size_t count, const ResourceAllocator<char>& allocator) : classId(id), slots(count, StackElement(), allocator) { }
+    };
+
+    struct StackElement::Closure
+    {
+        enum Kind
+        {
+            Curry,
+            Compose
+        };
+
+        Kind kind;
+        StackElement first;
+        StackElement second;
+
+        Closure(Kind k, StackElement&& f, StackElement&& s) : kind(k), first(std::move(f)), second(std::move(s)) { }
+    };
+
+    struct StackElement::Rope
+    {
+        // released once flattened
+        mutable StackElement left;
+        mutable StackElement right;
+        size_t length;
+        unsigned depth;
+
+        // what the flattened buffer is allocated from: wherever the rope was
+        ResourceAllocator<char> allocator;
+        mutable std::shared_ptr<const ValueString> flat;
+
+        Rope(StackElement&& l, StackElement&& r, unsigned d, const ResourceAllocator<char>& alloc) :
+            left(std::move(l)), right(std::move(r)), length(left.stringLength() + right.stringLength()), depth(d), allocator(alloc) { }
+
+        const ValueString& flatten() const;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+namespace throf
+{
+    // Runtime counters behind the `stats` word and the --stats exit report. Everything
+    // here is a plain increment or compare on paths the interpreter takes anyway; the
+    // StackElement allocation counters live in StackElement itself.
+    struct RuntimeStats
+    {
+        struct FileTimes
+        {
+            unsigned long long tokenizeNs;
+            unsigned long long compileNs;
+            unsigned long long executeNs;
+
+            FileTimes() : tokenizeNs(0), compileNs(0), executeNs(0) { }
+        };
+
+        // Adds the time spent in its scope to a counter.
+        class Timer
+        {
+            unsigned long long& _target;
+            std::chrono::steady_clock::time_point _start;
+
+            // block assignment
+            Timer& operator=(Timer& right) { return right; }
+
+        public:
+            explicit Timer(unsigned long long& target) : _target(target), _start(std::chrono::steady_clock::now())
+            {
+            }
+
+            ~Timer()
+            {
+                _target += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - _start).count();
+            }
+        };
+
+        // Tracks the depth of nested word calls, i.e. the return stack.
+        class CallScope
+        {
+            RuntimeStats& _stats;
+
+            // block assignment
+            CallScope& operator=(CallScope& right) { return right; }
+
+        public:
+            explicit CallScope(RuntimeStats& stats) : _stats(stats)
+            {
+                if (++_stats.returnStackDepth > _stats.peakReturnStackDepth)
+                {
+                    _stats.peakReturnStackDepth = _stats.returnStackDepth;
+                }
+            }
+
+            ~CallScope()
+            {
+                _stats.returnStackDepth--;
+            }
+        };
+
+        unsigned long long pushes;
+        unsigned long long pops;
+        size_t peakStackDepth;
+        size_t returnStackDepth;
+        size_t peakReturnStackDepth;
+        unsigned long long gcRuns;
+        unsigned long long reclaimedDefinitions;
+        unsigned long long reclaimedBytes;
+        std::map<std::string, FileTimes> files;
+
+        RuntimeStats() :
+            pushes(0),
+            pops(0),
+            peakStackDepth(0),
+            returnStackDepth(0),
+            peakReturnStackDepth(0),
+            gcRuns(0),
+            reclaimedDefinitions(0),
+            reclaimedBytes(0)
+        {
+        }
+    };
+}
@@ -31,14 +31,19 @@
 #include <stack>
 #include <vector>
 #include <array>
+#include <deque>
 #include <unordered_set>
 #include <unordered_map>
 #include <regex>
 #include <cctype>
+#include <cmath>
 #include <memory>
 #include <functional>
 #include <exception>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 #define STRINGIFY(e) #e
 #define printInfo(s, ...) ::printf("INFO: " s "\n", __VA_ARGS__)
@@ -47,5 +52,21 @@
 #include "throfexception.h"
 #include "common.h"
 #include "tokenizer.h"
+#include "recordreader.h"
+#include "memory.h"
+#include "quota.h"
+#include "symboltable.h"
+#include "biginteger.h"
 #include "stackelement.h"
-#include "interpreter.h"
\ No newline at end of file
+#include "hashmap.h"
+#include "numeric.h"
+#include "simd.h"
+#include "parallelsort.h"
+#include "eventloop.h"
+#include "profiler.h"
+#include "sampler.h"
+#include "tracer.h"
+#include "stats.h"
+#include "benchmark.h"
+#include "interpreter.h"
+#include "server.h"
\ No newline at end of file
@@ -0,0 +1,316 @@
+// throf-stress : generates synthetic throf programs at a given scale and measures how
+// the interpreter copes with them.
+//
+//   throf-stress [--throf <binary>] [--keep] <kind> <scale> [<kind> <scale> ...]
+//   throf-stress --generate <kind> <scale>
+//
+// Kinds and what their scale means:
+//
+//   definitions     number of distinct word definitions
+//   redefinitions   length of a chain of hyperstatic redefinitions of one word, each
+//                   calling the version before it
+//   nesting         depth of nested quotations
+//   size            size of the source in megabytes
+//
+// In the default mode every program is written to a temporary file and run with
+// `throf --stats`. The tokenize, compile and execute times are taken from the stats
+// report, wall time and peak RSS from wait4(). One tab separated line is printed per
+// run:
+//
+//   kind  scale  bytes  tokenize_ms  compile_ms  execute_ms  wall_ms  peak_rss_kb  status
+//
+// --generate writes the program to stdout instead; --keep leaves the generated files in
+// /tmp for a closer look.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+// The redefinition chain and the nested quotations are executed as well as compiled;
+// beyond this depth the interpreter's recursion guard stops them, so only compiling is
+// measured.
+static const long MAX_EXECUTED_DEPTH = 1000;
+
+static void generateDefinitions(std::ostream& out, long count)
+{
+    for (long ii = 0; ii < count; ii++)
+    {
+        out << ": def" << ii << " ( x -- y ) " << ii << " + ;" << std::endl;
+    }
+    out << "0 def" << count - 1 << " drop" << std::endl;
+}
+
+static void generateRedefinitions(std::ostream& out, long count)
+{
+    out << ": chain ( -- n ) 0 ;" << std::endl;
+    for (long ii = 1; ii < count; ii++)
+    {
+        out << ": chain ( -- n ) chain 1 + ;" << std::endl;
+    }
+    if (count <= MAX_EXECUTED_DEPTH)
+    {
+        out << "chain drop" << std::endl;
+    }
+}
+
+static void generateNesting(std::ostream& out, long depth)
+{
+    out << ": nested ( -- n ) " << std::endl;
+    for (long ii = 0; ii < depth; ii++)
+    {
+        out << "true [ ";
+    }
+    out << "1";
+    for (long ii = 0; ii < depth; ii++)
+    {
+        out << " ] [ 0 ] if";
+    }
+    out << " ;" << std::endl;
+    if (depth <= MAX_EXECUTED_DEPTH)
+    {
+        out << "nested drop" << std::endl;
+    }
+}
+
+// blocks of mixed source: comments, stack effect comments, strings and quotations
+static void generateSize(std::ostream& out, long megabytes)
+{
+    long target = megabytes * 1024 * 1024;
+    long written = 0;
+    for (long ii = 0; written < target; ii++)
+    {
+        std::stringstream block;
+        block << "# block " << ii << ", filler to reach the requested source size" << std::endl;
+        block << ": block" << ii << " ( x -- y )" << std::endl;
+        block << "    dup " << ii << " > [ " << ii << " - ] [ \"block " << ii << " string\" drop ] if ;" << std::endl;
+        if (ii % 100 == 0)
+        {
+            block << ii << " block" << ii << " drop" << std::endl;
+        }
+
+        std::string text = block.str();
+        out << text;
+        written += text.size();
+    }
+}
+
+static bool isKind(const std::string& kind)
+{
+    return kind == "definitions" || kind == "redefinitions" || kind == "nesting" || kind == "size";
+}
+
+static bool generate(std::ostream& out, const std::string& kind, long scale)
+{
+    if (kind == "definitions")
+    {
+        generateDefinitions(out, scale);
+    }
+    else if (kind == "redefinitions")
+    {
+        generateRedefinitions(out, scale);
+    }
+    else if (kind == "nesting")
+    {
+        generateNesting(out, scale);
+    }
+    else if (kind == "size")
+    {
+        generateSize(out, scale);
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+// picks the tokenize/compile/execute row for filename out of the --stats report
+static bool parseStats(const std::string& report, const std::string& filename, double times[3])
+{
+    std::istringstream lines(report);
+    std::string line;
+    std::string suffix = "  " + filename;
+    while (std::getline(lines, line))
+    {
+        if (line.size() > suffix.size() && 0 == line.compare(line.size() - suffix.size(), suffix.size(), suffix))
+        {
+            std::istringstream fields(line);
+            return static_cast<bool>(fields >> times[0] >> times[1] >> times[2]);
+        }
+    }
+    return false;
+}
+
+static void run(const std::string& throf, const std::string& kind, long scale, bool keep)
+{
+    char filename[] = "/tmp/throf-stress-XXXXXX";
+    int fd = mkstemp(filename);
+    if (fd < 0)
+    {
+        fprintf(stderr, "ERROR: mkstemp failed, errno = %d\n", errno);
+        return;
+    }
+    close(fd);
+
+    {
+        std::ofstream out(filename);
+        generate(out, kind, scale);
+    }
+
+    std::ifstream sizeCheck(filename, std::ios::binary | std::ios::ate);
+    long long bytes = static_cast<long long>(sizeCheck.tellg());
+
+    // the child's stdout comes back through a pipe so the stats report can be read
+    int pipeFds[2];
+    if (pipe(pipeFds) < 0)
+    {
+        fprintf(stderr, "ERROR: pipe failed, errno = %d\n", errno);
+        return;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        fprintf(stderr, "ERROR: fork failed, errno = %d\n", errno);
+        return;
+    }
+
+    if (pid == 0)
+    {
+        dup2(pipeFds[1], STDOUT_FILENO);
+        dup2(pipeFds[1], STDERR_FILENO);
+        close(pipeFds[0]);
+        close(pipeFds[1]);
+        execl(throf.c_str(), throf.c_str(), "--stats", filename, (char*)nullptr);
+        _exit(127);
+    }
+
+    close(pipeFds[1]);
+    std::string report;
+    char chunk[4096];
+    ssize_t bytesRead;
+    while ((bytesRead = read(pipeFds[0], chunk, sizeof(chunk))) != 0)
+    {
+        if (bytesRead < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (bytesRead < 0)
+        {
+            break;
+        }
+        report.append(chunk, bytesRead);
+    }
+    close(pipeFds[0]);
+
+    int status = 0;
+    struct rusage usage;
+    memset(&usage, 0, sizeof(usage));
+    while (wait4(pid, &status, 0, &usage) < 0 && errno == EINTR)
+    {
+    }
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    double times[3] = { 0, 0, 0 };
+    bool succeeded = WIFEXITED(status) && WEXITSTATUS(status) == 0 && report.find("ERROR:") == std::string::npos;
+    bool parsed = parseStats(report, filename, times);
+
+    // ru_maxrss is in kilobytes on Linux and in bytes on macOS
+#ifdef __APPLE__
+    long peakRssKb = usage.ru_maxrss / 1024;
+#else
+    long peakRssKb = usage.ru_maxrss;
+#endif
+
+    printf("%s\t%ld\t%lld\t%.3f\t%.3f\t%.3f\t%.3f\t%ld\t%s\n", kind.c_str(), scale, bytes,
+        times[0], times[1], times[2], wallMs, peakRssKb, (succeeded && parsed) ? "ok" : "FAILED");
+    fflush(stdout);
+
+    if (keep)
+    {
+        fprintf(stderr, "kept %s\n", filename);
+    }
+    else
+    {
+        unlink(filename);
+    }
+}
+
+static int usage()
+{
+    fprintf(stderr, "usage: throf-stress [--throf <binary>] [--keep] <kind> <scale> [<kind> <scale> ...]\n");
+    fprintf(stderr, "       throf-stress --generate <kind> <scale>\n");
+    fprintf(stderr, "kinds: definitions, redefinitions, nesting, size (megabytes)\n");
+    return 1;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string throf = "throf/throf";
+    bool keep = false;
+    bool generateOnly = false;
+    std::vector<std::pair<std::string, long> > runs;
+
+    for (int ii = 1; ii < argc; ii++)
+    {
+        if (0 == strcmp(argv[ii], "--throf") && ii + 1 < argc)
+        {
+            throf = argv[++ii];
+        }
+        else if (0 == strcmp(argv[ii], "--keep"))
+        {
+            keep = true;
+        }
+        else if (0 == strcmp(argv[ii], "--generate"))
+        {
+            generateOnly = true;
+        }
+        else if (argv[ii][0] != '-' && ii + 1 < argc)
+        {
+            runs.push_back(std::make_pair(std::string(argv[ii]), atol(argv[ii + 1])));
+            ii++;
+        }
+        else
+        {
+            return usage();
+        }
+    }
+
+    if (runs.empty())
+    {
+        return usage();
+    }
+
+    for (size_t ii = 0; ii < runs.size(); ii++)
+    {
+        if (runs[ii].second <= 0 || !isKind(runs[ii].first))
+        {
+            return usage();
+        }
+    }
+
+    if (generateOnly)
+    {
+        return generate(std::cout, runs[0].first, runs[0].second) ? 0 : 1;
+    }
+
+    printf("# kind\tscale\tbytes\ttokenize_ms\tcompile_ms\texecute_ms\twall_ms\tpeak_rss_kb\tstatus\n");
+    for (size_t ii = 0; ii < runs.size(); ii++)
+    {
+        run(throf, runs[ii].first, runs[ii].second, keep);
+    }
+    return 0;
+}
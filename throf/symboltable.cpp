@@ -0,0 +1,95 @@
+#include "stdafx.h"
+
+namespace throf
+{
+    namespace
+    {
+        // a view of an interned name, or of the text being looked up
+        struct Key
+        {
+            const char* data;
+            size_t length;
+        };
+
+        struct KeyHash
+        {
+            size_t operator()(const Key& key) const
+            {
+                // FNV-1a
+                uint64_t hash = 14695981039346656037ULL;
+                for (size_t ii = 0; ii < key.length; ii++)
+                {
+                    hash = (hash ^ static_cast<unsigned char>(key.data[ii])) * 1099511628211ULL;
+                }
+                return static_cast<size_t>(hash);
+            }
+        };
+
+        struct KeyEqual
+        {
+            bool operator()(const Key& left, const Key& right) const
+            {
+                return left.length == right.length && 0 == memcmp(left.data, right.data, left.length);
+            }
+        };
+
+        struct Table
+        {
+            // a deque so that names, and the keys pointing into them, never move
+            std::deque<ValueString> names;
+            std::unordered_map<Key, SymbolTable::Atom, KeyHash, KeyEqual> atoms;
+            size_t bytes;
+
+            Table() : bytes(0)
+            {
+                names.push_back(ValueString(ResourceAllocator<char>(heapResource())));
+                Key key = { names.back().data(), 0 };
+                atoms[key] = SymbolTable::EMPTY;
+            }
+        };
+
+        Table& table()
+        {
+            static Table s_table;
+            return s_table;
+        }
+    }
+
+    // static
+    SymbolTable::Atom SymbolTable::intern(const char* data, size_t length)
+    {
+        Table& symbols = table();
+        Key key = { data, length };
+        auto found = symbols.atoms.find(key);
+        if (found != symbols.atoms.end())
+        {
+            return found->second;
+        }
+
+        Atom atom = static_cast<Atom>(symbols.names.size());
+        symbols.names.push_back(ValueString(data, length, ResourceAllocator<char>(heapResource())));
+        symbols.bytes += length + 1;
+
+        Key stored = { symbols.names.back().data(), length };
+        symbols.atoms[stored] = atom;
+        return atom;
+    }
+
+    // static
+    const ValueString& SymbolTable::name(Atom atom)
+    {
+        return table().names[atom];
+    }
+
+    // static
+    size_t SymbolTable::size()
+    {
+        return table().names.size();
+    }
+
+    // static
+    size_t SymbolTable::bytes()
+    {
+        return table().bytes;
+    }
+}
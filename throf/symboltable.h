@@ -0,0 +1,33 @@
+#pragma once
+
+namespace throf
+{
+    // string values, allocated through ResourceAllocator like the rest of a value
+    typedef std::basic_string<char, std::char_traits<char>, ResourceAllocator<char>> ValueString;
+
+    // Interned strings. String literals from the source, variable names and word names
+    // are each stored once and referred to by a 32-bit atom, so that copying one is
+    // copying an integer and two of them are equal exactly when their atoms are.
+    //
+    // Atoms are never freed: what gets interned is bounded by the source loaded, not by
+    // what a script does at runtime, and strings built at runtime are not interned. The
+    // table is process wide, like the default memory resource, and its memory comes from
+    // the heap whatever the default resource is.
+    class SymbolTable
+    {
+    public:
+        typedef uint32_t Atom;
+
+        // the empty string, interned from the start
+        static const Atom EMPTY = 0;
+
+        static Atom intern(const char* data, size_t length);
+        static Atom intern(const std::string& text) { return intern(text.data(), text.size()); }
+
+        // the string atom was interned from; the reference stays valid for the process
+        static const ValueString& name(Atom atom);
+
+        static size_t size();
+        static size_t bytes();
+    };
+}
@@ -1,9 +1,12 @@
 #include "stdafx.h"
+#include <iostream>
 
 using namespace throf;
 
 extern int* TOP_OF_STACK;
 const char* const INIT_FILENAME = "init.th4";
+const char* const RECORD_WORD = "record";
+const char* const FINISH_WORD = "finish";
 
 void dumpTokens(Tokenizer& tokenizer)
 {
@@ -21,9 +24,7 @@ void loadInitFile(Interpreter& interpreter)
     if (nullptr != f)
     {
         fclose(f);
-        InputReader reader(INIT_FILENAME);
-        Tokenizer tokenizer = Tokenizer::tokenize(reader);
-        interpreter.loadFile(tokenizer);
+        interpreter.loadFile(INIT_FILENAME);
     }
 }
 
@@ -31,30 +32,154 @@ int main(int argc, char* argv[])
 {
     int __TOP_OF_STACK;
     TOP_OF_STACK = &__TOP_OF_STACK;
+
+    // options come before the mode/file arguments and are stripped off here
+    bool profile = false;
+    bool sample = false;
+    bool stats = false;
+    const char* traceFilename = nullptr;
+    Quota::Limits limits;
+    int argi = 1;
+    for (; argi < argc; argi++)
+    {
+        if (0 == strcmp(argv[argi], "--profile"))
+        {
+            profile = true;
+        }
+        else if (0 == strcmp(argv[argi], "--sample"))
+        {
+            sample = true;
+        }
+        else if (0 == strcmp(argv[argi], "--stats"))
+        {
+            stats = true;
+        }
+        else if (0 == strcmp(argv[argi], "--trace") && argi + 1 < argc)
+        {
+            traceFilename = argv[++argi];
+        }
+        else if (0 == strcmp(argv[argi], "--max-instructions") && argi + 1 < argc)
+        {
+            limits.instructions = strtoull(argv[++argi], nullptr, 10);
+        }
+        else if (0 == strcmp(argv[argi], "--max-stack-depth") && argi + 1 < argc)
+        {
+            limits.stackDepth = static_cast<size_t>(strtoull(argv[++argi], nullptr, 10));
+        }
+        else if (0 == strcmp(argv[argi], "--memory-limit") && argi + 1 < argc)
+        {
+            limits.memoryBytes = static_cast<size_t>(strtoull(argv[++argi], nullptr, 10));
+        }
+        else if (0 == strcmp(argv[argi], "--timeout") && argi + 1 < argc)
+        {
+            limits.timeMs = strtoull(argv[++argi], nullptr, 10);
+        }
+        else
+        {
+            break;
+        }
+    }
+    argc -= argi - 1;
+    argv += argi - 1;
+
+    if (argc > 1 && 0 == strcmp(argv[1], "-n"))
+    {
+        // batch output is only flushed in large blocks, not per record. This has to
+        // happen before anything is written to cout.
+        static char outputBuffer[1 << 16];
+        std::ios::sync_with_stdio(false);
+        std::cout.rdbuf()->pubsetbuf(outputBuffer, sizeof(outputBuffer));
+    }
+
     try
     {
         Interpreter interpreter;
+        if (profile)
+        {
+            interpreter.startProfiling();
+        }
+        if (sample)
+        {
+            interpreter.startSampling(Sampler::DEFAULT_FREQUENCY);
+        }
+        if (nullptr != traceFilename)
+        {
+            interpreter.startTracing(traceFilename);
+        }
         loadInitFile(interpreter);
 
+        // init.th4 is trusted and not charged; with --serve the limits apply to each
+        // request on its own
+        interpreter.setLimits(limits);
+
         if (argc == 1)
         {
             // REPL mode
             interpreter.repl();
         }
+        else if (0 == strcmp(argv[1], "-n"))
+        {
+            // batch mode: throf -n <script> < input
+            // the script's 'record' word runs once per input line
+            if (argc < 3)
+            {
+                printError("%s", "usage: throf -n <script> < input");
+                return 1;
+            }
+
+            interpreter.loadFile(argv[2]);
+
+            RecordReader records(stdin);
+            interpreter.processRecords(records, RECORD_WORD, FINISH_WORD);
+            std::cout.flush();
+        }
+        else if (0 == strcmp(argv[1], "--serve"))
+        {
+            // daemon mode: throf --serve <socket path> [files to preload...]
+            if (argc < 3)
+            {
+                printError("%s", "usage: throf --serve <socket path> [file ...]");
+                return 1;
+            }
+
+            for (int ii = 3; ii < argc; ii++)
+            {
+                interpreter.loadFile(argv[ii]);
+            }
+
+            Server server(interpreter, argv[2]);
+            server.run();
+        }
         else
         {
-            string filename = argv[1];
-            InputReader reader(filename);
-            Tokenizer tokenizer = Tokenizer::tokenize(reader);
-            interpreter.loadFile(tokenizer);
+            interpreter.loadFile(argv[1]);
+        }
+
+        if (profile)
+        {
+            interpreter.reportProfile();
+        }
+        if (sample)
+        {
+            interpreter.reportSamples();
+        }
+        if (nullptr != traceFilename)
+        {
+            interpreter.stopTracing();
+        }
+        if (stats)
+        {
+            std::cout << interpreter.statsToString();
         }
     }
     catch (const ThrofException& e)
     {
+        std::cout.flush();
         printf("ERROR: Error encountered while processing file:\n");
         printError("\tfilename: %s", e.filename());
         printError("\tcomponent: %s", e.component());
         printError("\texplanation: %s", e.what());
+        return 1;
     }
 
     return 0;
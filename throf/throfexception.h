@@ -52,4 +52,35 @@ namespace throf
             }
         }
     };
-}
\ No newline at end of file
+
+    // Raised when a script runs past one of the limits it was given (see Quota). It is
+    // reported like any other ThrofException, component "Quota", but has a type of its
+    // own so a host running untrusted scripts can abort the one at fault and carry on.
+    class QuotaExceeded : public ThrofException
+    {
+    private:
+        std::string _quota;
+
+    public:
+        QuotaExceeded
+        (
+            const std::string& quota,
+            const std::string& explanation
+        ) : ThrofException("Quota", explanation), _quota(quota)
+        { }
+
+        QuotaExceeded
+        (
+            const std::string& quota,
+            const std::string& explanation,
+            const std::string& filename
+        ) : ThrofException("Quota", explanation, filename), _quota(quota)
+        { }
+
+        // which limit: "instructions", "stack depth", "memory" or "time"
+        const char* quota() const throw()
+        {
+            return _quota.c_str();
+        }
+    };
+}
@@ -4,9 +4,11 @@ namespace throf
 {
     using namespace std;
 
-    Tokenizer::Tokenizer(const string& filename, const vector<Token>& tokens) : 
-        _tokens(tokens), _tokensIndex(0), _filename(filename)
+    // takes over the contents of tokens
+    Tokenizer::Tokenizer(const string& filename, vector<Token>& tokens) :
+        _tokensIndex(0), _filename(filename)
     {
+        _tokens.swap(tokens);
     }
 
     Tokenizer::~Tokenizer()
@@ -65,6 +67,43 @@ namespace throf
             return fetch_next_token(reader);
         };
 
+        // the inputs named in the ( inputs -- outputs ) stack effect a locals definition
+        // starts with, as LocalName tokens; the outputs are only documentation
+        auto fetch_locals = [fetch_next_token](InputReader& reader, vector<Token>& tokens)
+        {
+            auto next = [&reader, fetch_next_token]()
+            {
+                int c = -1;
+                while (reader.peek(c) && std::isspace(c))
+                {
+                    reader.getc(c);
+                }
+                if (!reader.peek(c))
+                {
+                    throw ThrofException("Tokenizer", "unexpected end of stream while parsing stack effect", reader.filename());
+                }
+                return fetch_next_token(reader);
+            };
+
+            if (0 != next().compare("("))
+            {
+                throw ThrofException("Tokenizer", "expected stack effect ( inputs -- outputs ) after ':: name'", reader.filename());
+            }
+
+            bool inputs = true;
+            for (string name = next(); 0 != name.compare(")"); name = next())
+            {
+                if (0 == name.compare("--"))
+                {
+                    inputs = false;
+                }
+                else if (inputs)
+                {
+                    tokens.push_back(Token(Token::TokenType::LocalName, name));
+                }
+            }
+        };
+
         auto get_token_type = [](string tok)
         {
             return (0 == tok.compare(";")) ? Token::TokenType::DefinitionTerminator : Token::TokenType::WordOrData;
@@ -72,7 +111,9 @@ namespace throf
 
         auto check_if_marker = [](InputReader& reader, int checkChar)
         {
-            auto throw_if_getc_failed = [reader, checkChar]()
+            // reader is captured by reference: a copy would duplicate the whole input
+            // buffer on every marker and make tokenizing quadratic in the file size
+            auto throw_if_getc_failed = [&reader, checkChar]()
             {
                 stringstream strBuilder;
                 strBuilder << "unexpected end of stream while parsing '" << static_cast<char>(checkChar) << "'";
@@ -118,6 +159,23 @@ namespace throf
             return std::isspace(space) && marker == ':';
         };
 
+        auto check_if_locals_definition_marker = [](InputReader& reader)
+        {
+            // a lone ':' near the end of the stream is left for the other checks
+            int chars[3] = { -1, -1, -1 };
+            int read = 0;
+            while (read < 3 && reader.getc(chars[read]))
+            {
+                read++;
+            }
+            for (int ii = 0; ii < read; ii++)
+            {
+                reader.ungetc();
+            }
+
+            return read == 3 && chars[0] == ':' && chars[1] == ':' && std::isspace(chars[2]);
+        };
+
         auto check_if_directive_marker = [fetch_next_token](InputReader& reader)
         {
             int marker = -1; int alphanumeric = -1;
@@ -216,6 +274,15 @@ namespace throf
                 reader.getc(c);
                 continue;
             }
+            // Word definition with named inputs
+            else if (c == ':' && check_if_locals_definition_marker(reader))
+            {
+                reader.getc(c);
+                strToken = fetch_definition(reader);
+                tokens.push_back(Token(Token::TokenType::LocalsDefinition, strToken));
+                fetch_locals(reader, tokens);
+                continue;
+            }
             // Word definition
             else if (c == ':' && check_if_definition_marker(reader))
             {                
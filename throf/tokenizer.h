@@ -4,18 +4,17 @@ namespace throf
 {
     class InputReader
     {
-        std::vector<int> _buffer;
+        std::string _buffer;
         size_t _index;
         std::string _filename;
 
         void slurpFile(FILE* fileHandle)
         {
-            _buffer.reserve(2000);
-            int c = fgetc(fileHandle);
-            while (c != EOF)
+            char chunk[1 << 16];
+            size_t bytesRead;
+            while ((bytesRead = fread(chunk, 1, sizeof(chunk), fileHandle)) > 0)
             {
-                _buffer.push_back(c);
-                c = fgetc(fileHandle);
+                _buffer.append(chunk, bytesRead);
             }
 
             fclose(fileHandle); // best effort
@@ -27,10 +26,7 @@ namespace throf
             if (isREPL)
             {
                 _filename = "REPL";
-                for (size_t ii = 0; ii < data.length() ; ii++)
-                {
-                    _buffer.push_back(data[ii]);
-                }
+                _buffer.swap(data);
             }
             else
             {
@@ -54,7 +50,7 @@ namespace throf
         {
             if (_index < _buffer.size())
             {
-                c = _buffer[_index++];
+                c = static_cast<unsigned char>(_buffer[_index++]);
                 return true;
             }
             return false;
@@ -109,7 +105,9 @@ namespace throf
             WordOrData,
             StringLiteral,
             QuotationOpen,          // "["
-            QuotationClose          // "]"
+            QuotationClose,         // "]"
+            LocalsDefinition,       // ":: "
+            LocalName               // an input named in the stack effect after ":: name"
         };
 
         // comparison operators
@@ -166,6 +164,6 @@ namespace throf
         size_t _tokensIndex;
         std::string _filename;
 
-        explicit Tokenizer(const std::string& filename, const std::vector<Token>& tokens);
+        explicit Tokenizer(const std::string& filename, std::vector<Token>& tokens);
     };
 }
\ No newline at end of file
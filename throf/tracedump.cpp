@@ -0,0 +1,179 @@
+// throf-trace : dumps a trace recorded with `throf --trace <file>` or the trace-on
+// word, either as indented text or as Chrome trace event JSON (chrome://tracing,
+// Perfetto).
+//
+//   throf-trace [--chrome] <trace file>
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "traceformat.h"
+
+using namespace throf;
+
+static bool readNames(FILE* f, uint32_t count, std::unordered_map<int32_t, std::string>& names)
+{
+    for (uint32_t ii = 0; ii < count; ii++)
+    {
+        int32_t id;
+        uint32_t length;
+        if (fread(&id, sizeof(id), 1, f) != 1 || fread(&length, sizeof(length), 1, f) != 1)
+        {
+            return false;
+        }
+
+        std::string name(length, '\0');
+        if (length > 0 && fread(&name[0], 1, length, f) != length)
+        {
+            return false;
+        }
+        names[id] = name;
+    }
+    return true;
+}
+
+static void writeJsonString(const std::string& s)
+{
+    putchar('"');
+    for (size_t ii = 0; ii < s.size(); ii++)
+    {
+        unsigned char c = s[ii];
+        if (c == '"' || c == '\\')
+        {
+            printf("\\%c", c);
+        }
+        else if (c < 0x20)
+        {
+            printf("\\u%04x", c);
+        }
+        else
+        {
+            putchar(c);
+        }
+    }
+    putchar('"');
+}
+
+int main(int argc, char* argv[])
+{
+    bool chrome = false;
+    const char* filename = nullptr;
+
+    for (int ii = 1; ii < argc; ii++)
+    {
+        if (0 == strcmp(argv[ii], "--chrome"))
+        {
+            chrome = true;
+        }
+        else
+        {
+            filename = argv[ii];
+        }
+    }
+
+    if (nullptr == filename)
+    {
+        fprintf(stderr, "usage: throf-trace [--chrome] <trace file>\n");
+        return 1;
+    }
+
+    FILE* f = fopen(filename, "rb");
+    if (nullptr == f)
+    {
+        fprintf(stderr, "ERROR: fopen failed for '%s', errno = %d\n", filename, errno);
+        return 1;
+    }
+
+    TraceHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        0 != memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) ||
+        header.version != TRACE_VERSION ||
+        header.eventSize != sizeof(TraceEvent))
+    {
+        fprintf(stderr, "ERROR: '%s' is not a throf trace (version %u)\n", filename, TRACE_VERSION);
+        return 1;
+    }
+
+    // the names come last, so the events are buffered until they have been read
+    std::vector<TraceEvent> events;
+    std::unordered_map<int32_t, std::string> names;
+    unsigned long long dropped = 0;
+    bool complete = false;
+
+    TraceEvent ev;
+    while (fread(&ev, sizeof(ev), 1, f) == 1)
+    {
+        if (ev.kind == TRACE_NAMES)
+        {
+            dropped = ev.timestampNs;
+            complete = readNames(f, static_cast<uint32_t>(ev.wordId), names);
+            break;
+        }
+        events.push_back(ev);
+    }
+    fclose(f);
+
+    if (!complete)
+    {
+        fprintf(stderr, "WARNING: trace is truncated, word names are unavailable\n");
+    }
+    if (dropped > 0)
+    {
+        fprintf(stderr, "WARNING: %llu events were dropped while recording\n", dropped);
+    }
+
+    auto nameOf = [&names](int32_t id)
+    {
+        auto itr = names.find(id);
+        return itr != names.end() ? (*itr).second : std::to_string(id);
+    };
+
+    if (chrome)
+    {
+        printf("{\"traceEvents\":[\n");
+        for (size_t ii = 0; ii < events.size(); ii++)
+        {
+            const TraceEvent& e = events[ii];
+            printf("%s{\"name\":", ii == 0 ? "" : ",\n");
+            writeJsonString(nameOf(e.wordId));
+            printf(",\"cat\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":1,\"args\":{\"depth\":%u}}",
+                (e.flags & TRACE_FLAG_PRIMITIVE) ? "primitive" : "word",
+                e.kind == TRACE_ENTER ? "B" : "E",
+                e.timestampNs / 1000.0,
+                static_cast<unsigned>(e.depth));
+        }
+        printf("\n]}\n");
+    }
+    else
+    {
+        int nesting = 0;
+        for (size_t ii = 0; ii < events.size(); ii++)
+        {
+            const TraceEvent& e = events[ii];
+            if (e.kind == TRACE_EXIT && nesting > 0)
+            {
+                nesting--;
+            }
+
+            printf("%14.3f us  depth %5u  %*s%s %s%s\n",
+                e.timestampNs / 1000.0,
+                static_cast<unsigned>(e.depth),
+                nesting * 2, "",
+                e.kind == TRACE_ENTER ? ">" : "<",
+                nameOf(e.wordId).c_str(),
+                (e.flags & TRACE_FLAG_PRIMITIVE) ? " (primitive)" : "");
+
+            if (e.kind == TRACE_ENTER)
+            {
+                nesting++;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace throf
+{
+    // On-disk layout of execution traces, shared by the interpreter's Tracer and the
+    // throf-trace dump tool.
+    //
+    //   TraceHeader
+    //   TraceEvent ...                 enter/exit events, in order
+    //   TraceEvent (kind TRACE_NAMES)  wordId = number of name records that follow,
+    //                                  timestampNs = number of dropped events
+    //   { int32 id, uint32 length, char name[length] } ...
+    //
+    // Word ids are the op_code ids from common.h for primitives and the
+    // _stringToWordDict ids otherwise; the name table at the end maps them back.
+
+    const char TRACE_MAGIC[8] = { 'T', 'H', 'R', 'O', 'F', 'T', 'R', 'C' };
+    const uint32_t TRACE_VERSION = 1;
+
+    const uint8_t TRACE_ENTER = 1;
+    const uint8_t TRACE_EXIT = 2;
+    const uint8_t TRACE_NAMES = 3;
+
+    const uint8_t TRACE_FLAG_PRIMITIVE = 1;
+
+    struct TraceHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t eventSize;
+    };
+
+    struct TraceEvent
+    {
+        uint64_t timestampNs;   // since the trace was started
+        int32_t wordId;
+        uint16_t depth;         // data stack depth, saturated at 0xffff
+        uint8_t kind;
+        uint8_t flags;
+    };
+}
@@ -0,0 +1,153 @@
+#include "stdafx.h"
+#include <chrono>
+
+namespace throf
+{
+    using namespace std;
+
+    const size_t Tracer::RING_SIZE;
+
+    static unsigned long long nowNs()
+    {
+        return chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    Tracer::Tracer() :
+        _enabled(false),
+        _lastPrimitive(0),
+        _startNs(0),
+        _file(nullptr),
+        _head(0),
+        _tail(0),
+        _stopping(false),
+        _dropped(0)
+    {
+        for (auto itr = PRIM_WORD_TO_STR_MAP.cbegin(); itr != PRIM_WORD_TO_STR_MAP.cend(); itr++)
+        {
+            _lastPrimitive = max(_lastPrimitive, (*itr).first);
+        }
+    }
+
+    Tracer::~Tracer()
+    {
+        if (_enabled)
+        {
+            stop(WordNames());
+        }
+    }
+
+    void Tracer::start(const string& filename)
+    {
+        ThrofException::throwIfTrue(_enabled, "Tracer", "a trace is already being recorded");
+
+        _file = fopen(filename.c_str(), "wb");
+        if (nullptr == _file)
+        {
+            stringstream strBuilder;
+            strBuilder << "fopen failed for '" << filename << "', errno = " << errno;
+            throw ThrofException("Tracer", strBuilder.str());
+        }
+
+        TraceHeader header;
+        memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+        header.version = TRACE_VERSION;
+        header.eventSize = sizeof(TraceEvent);
+        fwrite(&header, sizeof(header), 1, _file);
+
+        if (_ring.empty())
+        {
+            _ring.resize(RING_SIZE);
+        }
+        _head.store(0);
+        _tail.store(0);
+        _dropped.store(0);
+        _stopping.store(false);
+        _startNs = nowNs();
+
+        _flusher = thread(&Tracer::flushLoop, this);
+        _enabled = true;
+    }
+
+    void Tracer::stop(const WordNames& names)
+    {
+        if (!_enabled)
+        {
+            return;
+        }
+        _enabled = false;
+
+        _stopping.store(true);
+        _flusher.join();
+        flush();
+
+        TraceEvent trailer;
+        memset(&trailer, 0, sizeof(trailer));
+        trailer.kind = TRACE_NAMES;
+        trailer.wordId = static_cast<int32_t>(names.size());
+        trailer.timestampNs = _dropped.load();
+        fwrite(&trailer, sizeof(trailer), 1, _file);
+
+        for (auto itr = names.cbegin(); itr != names.cend(); itr++)
+        {
+            int32_t id = (*itr).first;
+            uint32_t length = static_cast<uint32_t>((*itr).second.size());
+            fwrite(&id, sizeof(id), 1, _file);
+            fwrite(&length, sizeof(length), 1, _file);
+            fwrite((*itr).second.data(), 1, length, _file);
+        }
+
+        fclose(_file);
+        _file = nullptr;
+    }
+
+    void Tracer::record(uint8_t kind, WORD_ID id, size_t depth)
+    {
+        size_t head = _head.load(memory_order_relaxed);
+        if (head - _tail.load(memory_order_acquire) >= RING_SIZE)
+        {
+            _dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+
+        TraceEvent& ev = _ring[head % RING_SIZE];
+        ev.timestampNs = nowNs() - _startNs;
+        ev.wordId = id;
+        ev.depth = static_cast<uint16_t>(depth > 0xffff ? 0xffff : depth);
+        ev.kind = kind;
+        ev.flags = (id <= _lastPrimitive) ? TRACE_FLAG_PRIMITIVE : 0;
+
+        _head.store(head + 1, memory_order_release);
+    }
+
+    // Writes out everything published so far; returns the number of events written.
+    size_t Tracer::flush()
+    {
+        size_t head = _head.load(memory_order_acquire);
+        size_t tail = _tail.load(memory_order_relaxed);
+        size_t count = head - tail;
+
+        while (tail != head)
+        {
+            // write contiguous runs straight out of the ring
+            size_t offset = tail % RING_SIZE;
+            size_t run = min(head - tail, RING_SIZE - offset);
+            fwrite(&_ring[offset], sizeof(TraceEvent), run, _file);
+            tail += run;
+            _tail.store(tail, memory_order_release);
+        }
+
+        return count;
+    }
+
+    void Tracer::flushLoop()
+    {
+        while (!_stopping.load())
+        {
+            if (flush() == 0)
+            {
+                this_thread::sleep_for(chrono::milliseconds(1));
+            }
+        }
+    }
+}
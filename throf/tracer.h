@@ -0,0 +1,77 @@
+#pragma once
+
+#include "traceformat.h"
+
+namespace throf
+{
+    // Opt-in execution tracer behind --trace and the trace-on / trace-off words.
+    // dispatch records a fixed size TraceEvent for every word entered and left into a
+    // single-producer/single-consumer ring; a background thread drains the ring to the
+    // trace file so the interpreter never blocks on I/O. If the flusher falls behind,
+    // events are dropped and counted rather than stalling execution.
+    //
+    // Use the throf-trace tool to turn the file into text or Chrome trace JSON.
+    class Tracer
+    {
+    public:
+        typedef unordered_map<WORD_ID, std::string> WordNames;
+
+        class Scope
+        {
+            Tracer& _tracer;
+            const CodeVector& _stack;
+            WORD_ID _id;
+            bool _active;
+
+            // block assignment
+            Scope& operator=(Scope& right) { return right; }
+
+        public:
+            Scope(Tracer& tracer, WORD_ID id, const CodeVector& stack) :
+                _tracer(tracer), _stack(stack), _id(id), _active(tracer._enabled)
+            {
+                if (_active)
+                {
+                    _tracer.record(TRACE_ENTER, _id, _stack.size());
+                }
+            }
+
+            ~Scope()
+            {
+                if (_active)
+                {
+                    _tracer.record(TRACE_EXIT, _id, _stack.size());
+                }
+            }
+        };
+
+        Tracer();
+        ~Tracer();
+
+        void start(const std::string& filename);
+        void stop(const WordNames& names);
+        bool enabled() const { return _enabled; }
+
+    private:
+        static const size_t RING_SIZE = 1 << 16;
+
+        void record(uint8_t kind, WORD_ID id, size_t depth);
+        void flushLoop();
+        size_t flush();
+
+        // block assignment
+        Tracer& operator=(Tracer& right) { return right; }
+
+        bool _enabled;
+        WORD_ID _lastPrimitive;
+        unsigned long long _startNs;
+        FILE* _file;
+
+        std::vector<TraceEvent> _ring;
+        std::atomic<size_t> _head;
+        std::atomic<size_t> _tail;
+        std::atomic<bool> _stopping;
+        std::atomic<unsigned long long> _dropped;
+        std::thread _flusher;
+    };
+}